@@ -0,0 +1,178 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <algorithm>
+#include <vector>
+
+#ifndef ALGEBRA
+#define ALGEBRA
+
+using namespace std;
+
+/**
+ * An algebra of the noncommutative variables with a direct normal ordering
+ * routine. It replaces the generic substitution rules that would otherwise
+ * encode the same relations. Words are given as variable indices, and the
+ * relations must map a monomial to plus or minus a single monomial.
+ */
+class Algebra {
+
+public:
+	virtual ~Algebra() {
+	}
+
+	/**
+	 * Bring a word to normal form in place.
+	 *
+	 * Returns the sign picked up by the reordering, 1 or -1.
+	 */
+	virtual int normalOrder(vector<unsigned int> &word) const = 0;
+};
+
+/**
+ * Ordering policy of fully noncommuting variables.
+ */
+struct Noncommuting {
+	static int order(vector<unsigned int> &word,
+			const vector<unsigned int> &parties) {
+		return 1;
+	}
+};
+
+/**
+ * Ordering policy of variables that commute across parties, for instance
+ * operators acting on different sites. Letters are sorted by their party,
+ * and the order within a party is kept.
+ */
+struct CommutingParties {
+	static unsigned int party(const unsigned int letter,
+			const vector<unsigned int> &parties) {
+		return letter < parties.size() ? parties[letter] : letter;
+	}
+
+	static int order(vector<unsigned int> &word,
+			const vector<unsigned int> &parties) {
+		for (size_t i = 1; i < word.size(); ++i) {
+			unsigned int letter = word[i];
+			size_t j = i;
+			for (; j > 0 && party(word[j - 1], parties) > party(letter, parties);
+					--j) {
+				word[j] = word[j - 1];
+			}
+			word[j] = letter;
+		}
+		return 1;
+	}
+};
+
+/**
+ * Ordering policy of variables that anticommute across parties, such as
+ * Majorana modes. Every swap of letters from different parties flips the
+ * sign.
+ */
+struct AnticommutingParties {
+	static int order(vector<unsigned int> &word,
+			const vector<unsigned int> &parties) {
+		int sign = 1;
+		for (size_t i = 1; i < word.size(); ++i) {
+			unsigned int letter = word[i];
+			size_t j = i;
+			for (;
+					j > 0
+							&& CommutingParties::party(word[j - 1], parties)
+									> CommutingParties::party(letter, parties);
+					--j) {
+				word[j] = word[j - 1];
+				sign = -sign;
+			}
+			word[j] = letter;
+		}
+		return sign;
+	}
+};
+
+/**
+ * Reduction policy that leaves repeated letters alone.
+ */
+struct NoReduction {
+	static void reduce(vector<unsigned int> &word) {
+	}
+};
+
+/**
+ * Reduction policy of projectors, X^2 = X.
+ */
+struct Projector {
+	static void reduce(vector<unsigned int> &word) {
+		word.erase(unique(word.begin(), word.end()), word.end());
+	}
+};
+
+/**
+ * Reduction policy of Hermitian unitaries, X^2 = 1. Cancelling a pair may
+ * bring another pair together, so the word is reduced like a stack.
+ */
+struct Involution {
+	static void reduce(vector<unsigned int> &word) {
+		size_t top = 0;
+		for (size_t i = 0; i < word.size(); ++i) {
+			if (top > 0 && word[top - 1] == word[i]) {
+				--top;
+			} else {
+				word[top++] = word[i];
+			}
+		}
+		word.resize(top);
+	}
+};
+
+/**
+ * Normal ordering composed of an ordering policy and a reduction policy at
+ * compile time. The parties assign a party to each variable; by default,
+ * every variable is a party of its own.
+ */
+template<class Ordering, class Reduction>
+class NormalOrdering: public Algebra {
+
+private:
+	const vector<unsigned int> parties;
+
+public:
+	NormalOrdering(const vector<unsigned int> &parties =
+			vector<unsigned int>()) :
+			parties(parties) {
+	}
+
+	int normalOrder(vector<unsigned int> &word) const {
+		int sign = Ordering::order(word, parties);
+		Reduction::reduce(word);
+		return sign;
+	}
+};
+
+typedef NormalOrdering<Noncommuting, Projector> Projectors;
+typedef NormalOrdering<Noncommuting, Involution> Unitaries;
+typedef NormalOrdering<CommutingParties, NoReduction> CommutingSites;
+typedef NormalOrdering<CommutingParties, Projector> CommutingProjectors;
+typedef NormalOrdering<CommutingParties, Involution> CommutingUnitaries;
+typedef NormalOrdering<AnticommutingParties, Involution> MajoranaModes;
+
+#endif
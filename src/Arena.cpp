@@ -0,0 +1,118 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "Arena.h"
+
+Arena::Arena(const size_t chunkSize) :
+		cursor(NULL), remaining(0), chunkSize(chunkSize), reserved(0) {
+}
+
+Arena::~Arena() {
+	release();
+}
+
+/**
+ * Bump the cursor in the current chunk. Requests that do not fit in a chunk
+ * get a chunk of their own.
+ */
+void *Arena::allocate(size_t bytes) {
+	bytes = (bytes + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+	if (bytes > remaining) {
+		size_t size = bytes > chunkSize ? bytes : chunkSize;
+		cursor = static_cast<char *>(::operator new(size));
+		remaining = size;
+		chunks.push_back(cursor);
+		reserved.fetch_add(size, memory_order_relaxed);
+	}
+	void *result = cursor;
+	cursor += bytes;
+	remaining -= bytes;
+	return result;
+}
+
+void Arena::release() {
+	for (vector<char *>::iterator i = chunks.begin(); i != chunks.end(); ++i) {
+		::operator delete(*i);
+	}
+	chunks.clear();
+	cursor = NULL;
+	remaining = 0;
+	reserved = 0;
+}
+
+/**
+ * Returns the number of bytes reserved from the system, which can be
+ * called while other threads allocate.
+ */
+size_t Arena::bytes() const {
+	return reserved.load(memory_order_relaxed);
+}
+
+ArenaPool::ArenaPool() {
+	release();
+}
+
+ArenaPool::~ArenaPool() {
+	for (vector<Arena *>::iterator i = arenas.begin(); i != arenas.end(); ++i) {
+		delete *i;
+	}
+}
+
+/**
+ * Returns the arena of the calling thread.
+ */
+Arena &ArenaPool::local() {
+#ifdef _OPENMP
+	return *arenas[omp_get_thread_num()];
+#else
+	return *arenas[0];
+#endif
+}
+
+/**
+ * Release the memory of every arena at once. This is also where the pool
+ * adapts to the number of threads of subsequent parallel regions, so it must
+ * be called outside of them.
+ */
+void ArenaPool::release() {
+	size_t nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	for (vector<Arena *>::iterator i = arenas.begin(); i != arenas.end(); ++i) {
+		(*i)->release();
+	}
+	while (arenas.size() < nThreads) {
+		arenas.push_back(new Arena());
+	}
+}
+
+size_t ArenaPool::bytes() const {
+	size_t total = 0;
+	for (vector<Arena *>::const_iterator i = arenas.begin(); i != arenas.end();
+			++i) {
+		total += (*i)->bytes();
+	}
+	return total;
+}
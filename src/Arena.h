@@ -0,0 +1,153 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifndef ARENA
+#define ARENA
+
+using namespace std;
+
+#define ARENA_CHUNK_SIZE (1 << 20)
+#define ARENA_ALIGNMENT 16
+
+/**
+ * Bump allocator that hands out memory from large chunks. Individual
+ * allocations are never freed, the whole arena is released at once.
+ */
+class Arena {
+
+private:
+	vector<char *> chunks;
+	char *cursor;
+	size_t remaining;
+	size_t chunkSize;
+	// Read by other threads to report the memory use
+	atomic<size_t> reserved;
+
+public:
+	Arena(const size_t chunkSize = ARENA_CHUNK_SIZE);
+	~Arena();
+	void *allocate(size_t bytes);
+	void release();
+	size_t bytes() const;
+};
+
+/**
+ * One arena per OpenMP thread, so that threads allocating at the same time
+ * never contend for a lock.
+ */
+class ArenaPool {
+
+private:
+	vector<Arena *> arenas;
+
+public:
+	ArenaPool();
+	~ArenaPool();
+	Arena &local();
+	void release();
+	size_t bytes() const;
+};
+
+/**
+ * STL allocator drawing from the arena of the calling thread. Deallocation
+ * is a no-op, the memory returns when the pool is released.
+ */
+template<class T>
+class ArenaAllocator {
+
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<class U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaPool *pool;
+
+	ArenaAllocator(ArenaPool *pool = NULL) :
+			pool(pool) {
+	}
+
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U> &other) :
+			pool(other.pool) {
+	}
+
+	pointer address(reference x) const {
+		return &x;
+	}
+
+	const_pointer address(const_reference x) const {
+		return &x;
+	}
+
+	pointer allocate(size_type n, const void * = 0) {
+		if (pool == NULL) {
+			return static_cast<pointer>(::operator new(n * sizeof(T)));
+		}
+		return static_cast<pointer>(pool->local().allocate(n * sizeof(T)));
+	}
+
+	void deallocate(pointer p, size_type) {
+		if (pool == NULL) {
+			::operator delete(p);
+		}
+	}
+
+	size_type max_size() const {
+		return size_t(-1) / sizeof(T);
+	}
+
+	template<class U, class ... Args>
+	void construct(U *p, Args&&... args) {
+		::new ((void *) p) U(std::forward<Args>(args)...);
+	}
+
+	template<class U>
+	void destroy(U *p) {
+		p->~U();
+	}
+
+	template<class U>
+	bool operator==(const ArenaAllocator<U> &other) const {
+		return pool == other.pool;
+	}
+
+	template<class U>
+	bool operator!=(const ArenaAllocator<U> &other) const {
+		return pool != other.pool;
+	}
+};
+
+#endif
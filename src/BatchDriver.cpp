@@ -0,0 +1,250 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "BatchDriver.h"
+
+BatchDriver::BatchDriver() :
+		nWorking(0) {
+	algebras["none"] = NULL;
+	algebras["projectors"] = new Projectors();
+	algebras["unitaries"] = new Unitaries();
+}
+
+BatchDriver::~BatchDriver() {
+	for (map<string, const Algebra *>::iterator algebra = algebras.begin();
+			algebra != algebras.end(); ++algebra) {
+		delete algebra->second;
+	}
+}
+
+/**
+ * Read the jobs of a batch from a manifest file. Every line is a job, blank
+ * lines and lines starting with # are skipped:
+ *
+ *   <problem> <variables> <order> <output> [<algebra>] [gzip]
+ *
+ * where the algebra is none, projectors or unitaries, none by default, and
+ * gzip asks for compressed output. Nothing is added if a line is malformed.
+ *
+ * Arguments:
+ * @param filename - the name of the manifest
+ */
+bool BatchDriver::readManifest(const char *filename) {
+	ifstream infile(filename);
+	if (!infile) {
+		cerr << "Cannot open " << filename << endl;
+		return false;
+	}
+	vector<BatchJob> manifest;
+	string line;
+	int lineNumber = 0;
+	while (getline(infile, line)) {
+		++lineNumber;
+		istringstream tokens(line);
+		BatchJob job;
+		if (!(tokens >> job.problem) || job.problem[0] == '#') {
+			continue;
+		}
+		job.algebra = "none";
+		job.compression = SDPA_PLAIN;
+		bool valid = (tokens >> job.nVars >> job.order >> job.output)
+				&& job.nVars > 0 && job.order > 0;
+		string option;
+		while (valid && tokens >> option) {
+			if (option == "gzip") {
+				job.compression = SDPA_GZIP;
+			} else if (algebras.count(option) > 0) {
+				job.algebra = option;
+			} else {
+				valid = false;
+			}
+		}
+		if (!valid) {
+			cerr << filename << ":" << lineNumber << ": not a job: " << line
+					<< endl;
+			return false;
+		}
+		manifest.push_back(job);
+	}
+	jobs.insert(jobs.end(), manifest.begin(), manifest.end());
+	return true;
+}
+
+void BatchDriver::addJob(const BatchJob &job) {
+	jobs.push_back(job);
+}
+
+/**
+ * Create the variables and the bases of the jobs up front, so that the
+ * workers only ever read them. Returns false if a job names an algebra
+ * that is not known.
+ */
+bool BatchDriver::prepare() {
+	for (vector<BatchJob>::const_iterator job = jobs.begin();
+			job != jobs.end(); ++job) {
+		if (algebras.count(job->algebra) == 0) {
+			cerr << "Unknown algebra " << job->algebra << " for "
+					<< job->problem << endl;
+			return false;
+		}
+		if (variables.count(job->nVars) == 0) {
+			Symbolic X("X", job->nVars);
+			X = ~X;
+			variables[job->nVars] = X;
+		}
+		pair<unsigned int, short int> key(job->nVars, job->order);
+		if (bases.count(key) == 0) {
+			bases[key] = SdpRelaxation::getNcMonomials(variables[job->nVars],
+					job->order);
+		}
+	}
+	return true;
+}
+
+/**
+ * Hand a finished relaxation over to the writer, or NULL for a job that
+ * failed. Waits while the writer is behind by maxPending relaxations, which
+ * bounds the memory held by relaxations that are done but not yet written.
+ */
+void BatchDriver::enqueue(const size_t job, SdpRelaxation *relaxation,
+		const size_t maxPending) {
+	unique_lock<mutex> lock(finishedMutex);
+	finishedChanged.wait(lock, [&]() {
+		return finished.size() < maxPending;
+	});
+	finished.push(make_pair(job, relaxation));
+	finishedChanged.notify_all();
+}
+
+/**
+ * Take the relaxations off the queue and write them until the queue is
+ * empty and no worker is left. Counts the jobs that failed to build or to
+ * be written.
+ */
+void BatchDriver::write(size_t *nFailed) {
+	while (true) {
+		pair<size_t, SdpRelaxation *> next;
+		{
+			unique_lock<mutex> lock(finishedMutex);
+			finishedChanged.wait(lock, [&]() {
+				return !finished.empty() || nWorking == 0;
+			});
+			if (finished.empty()) {
+				return;
+			}
+			next = finished.front();
+			finished.pop();
+			finishedChanged.notify_all();
+		}
+		const BatchJob &job = jobs[next.first];
+		if (next.second == NULL) {
+			cerr << "Failed to relax " << job.problem << endl;
+			++*nFailed;
+			continue;
+		}
+		bool written = next.second->writeToSdpa(job.output.c_str(),
+				job.compression);
+		delete next.second;
+		if (!written) {
+			cerr << "Failed to write " << job.output << endl;
+			++*nFailed;
+			continue;
+		}
+		cout << "Wrote " << job.output << endl;
+	}
+}
+
+/**
+ * Run the jobs of the batch and write their relaxations. Returns the
+ * number of jobs that failed.
+ *
+ * The jobs share a pool of worker threads, and the OpenMP threads are split
+ * evenly among the workers. Under MPI, the ranks are not used: every job is
+ * built by a single process, so the driver should be run without mpirun.
+ * With more than one worker, SymbolicC++ needs the same patch for
+ * thread-safety as with OpenMP.
+ *
+ * Arguments:
+ * @param nWorkers - the number of jobs built at the same time
+ */
+size_t BatchDriver::run(const int nWorkers) {
+	if (!prepare()) {
+		return jobs.size();
+	}
+	size_t workers = nWorkers > 0 ? nWorkers : 1;
+	if (workers > jobs.size()) {
+		workers = jobs.size() > 0 ? jobs.size() : 1;
+	}
+#ifdef _OPENMP
+	int threadsPerWorker = max(1, omp_get_max_threads() / (int) workers);
+#endif
+	nWorking = workers;
+	size_t nFailed = 0;
+	thread writer(&BatchDriver::write, this, &nFailed);
+
+	atomic<size_t> nextJob(0);
+	vector<thread> pool;
+	for (size_t i = 0; i < workers; ++i) {
+		pool.push_back(thread([&]() {
+#ifdef _OPENMP
+			omp_set_num_threads(threadsPerWorker);
+#endif
+			for (size_t k = nextJob++; k < jobs.size(); k = nextJob++) {
+				const BatchJob &job = jobs[k];
+				// The shared maps are only read here, with at(), since
+				// operator[] is not safe to call from several threads
+				SparseProblem problem;
+				SdpRelaxation *relaxation = NULL;
+				if (problem.read(job.problem.c_str())) {
+					relaxation = new SdpRelaxation(
+							unordered_map<Symbolic, Symbolic, hashMonomial>(),
+							algebras.at(job.algebra));
+					relaxation->setVerbose(false);
+					relaxation->setBasis(
+							&bases.at(make_pair(job.nVars, job.order)));
+					relaxation->getRelaxation(variables.at(job.nVars), problem,
+							job.order);
+					if (relaxation->getStatus() != BUILD_DONE) {
+						delete relaxation;
+						relaxation = NULL;
+					}
+				}
+				enqueue(k, relaxation, workers);
+			}
+			lock_guard<mutex> lock(finishedMutex);
+			--nWorking;
+			finishedChanged.notify_all();
+		}));
+	}
+	for (size_t i = 0; i < pool.size(); ++i) {
+		pool[i].join();
+	}
+	writer.join();
+	return nFailed;
+}
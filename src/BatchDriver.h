@@ -0,0 +1,93 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+#include "SdpRelaxation.h"
+
+#ifndef BATCH_DRIVER
+#define BATCH_DRIVER
+
+using namespace std;
+
+/**
+ * A relaxation to build as part of a batch: the problem file read by
+ * SparseProblem, the number of noncommutative variables, the order of the
+ * relaxation, the SDPA file to write and the built-in algebra of the
+ * variables, if any.
+ */
+struct BatchJob {
+
+	string problem;
+	unsigned int nVars;
+	short int order;
+	string output;
+	string algebra;
+	SdpaCompression compression;
+
+};
+
+/**
+ * Driver of many independent relaxations. The jobs are built concurrently
+ * by a pool of worker threads, each of which spreads its build over its
+ * share of the OpenMP threads. The variables and the monomial bases are
+ * created once for every number of variables and order, and the algebras
+ * once for the whole batch, then shared by the jobs that need them. A
+ * finished relaxation is handed to a writer thread, so that the next build
+ * overlaps the output of the previous one.
+ *
+ * Substitution rules are not supported: every job is built with an empty
+ * substitution map, and the only rewriting of the words is that of the
+ * built-in algebra named in the job. Problems that need substitution rules
+ * have to be built with SdpRelaxation directly.
+ */
+class BatchDriver {
+
+private:
+	vector<BatchJob> jobs;
+	map<unsigned int, Symbolic> variables;
+	map<pair<unsigned int, short int>, vector<Symbolic> > bases;
+	map<string, const Algebra *> algebras;
+	// Relaxations waiting to be written, with the index of their job
+	queue<pair<size_t, SdpRelaxation *> > finished;
+	mutex finishedMutex;
+	condition_variable finishedChanged;
+	size_t nWorking;
+
+	bool prepare();
+	void write(size_t *nFailed);
+	void enqueue(const size_t job, SdpRelaxation *relaxation,
+			const size_t maxPending);
+
+public:
+	BatchDriver();
+	~BatchDriver();
+	bool readManifest(const char *filename);
+	void addJob(const BatchJob &job);
+	size_t run(const int nWorkers);
+};
+
+#endif
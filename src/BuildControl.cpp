@@ -0,0 +1,318 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <sys/time.h>
+#include <iomanip>
+#include "BuildControl.h"
+
+// The callback is invoked about this many times per build
+#define PROGRESS_REPORTS 100
+
+const char *getStatusName(const BuildStatus status) {
+	switch (status) {
+	case BUILD_RUNNING:
+		return "running";
+	case BUILD_DONE:
+		return "done";
+	case BUILD_CANCELLED:
+		return "cancelled";
+	case BUILD_OUT_OF_TIME:
+		return "time budget exceeded";
+	case BUILD_OUT_OF_MEMORY:
+		return "memory budget exceeded";
+	case BUILD_INVALID:
+		return "invalid problem";
+	}
+	return "unknown";
+}
+
+const char *getStructureName(const MemoryStructure structure) {
+	switch (structure) {
+	case MEMORY_CONSTRAINTS:
+		return "constraint matrices";
+	case MEMORY_DICTIONARY:
+		return "monomial dictionary";
+	case MEMORY_OBJECTIVE:
+		return "objective function";
+	case MEMORY_BASIS:
+		return "monomial basis";
+	case MEMORY_VARIABLES:
+		return "variable numbering";
+	default:
+		return "unknown";
+	}
+}
+
+size_t MemoryUsage::getTotal() const {
+	size_t total = 0;
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		total += bytes[i];
+	}
+	return total;
+}
+
+BuildControl::BuildControl() :
+		status(BUILD_DONE), stage("idle"), rowsDone(0), rowsTotal(0),
+		elementsDone(0), elementsTotal(0), entries(0), nextReport(0),
+		usageKept(false), exceeded(-1), armed(false), start(0),
+		callback(NULL), callbackData(NULL) {
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		usage[i] = 0;
+		stopUsage[i] = 0;
+	}
+}
+
+void BuildControl::setBudget(const BuildBudget &budget) {
+	this->budget = budget;
+}
+
+void BuildControl::setCallback(ProgressCallback callback, void *data) {
+	this->callback = callback;
+	callbackData = data;
+}
+
+/**
+ * Helper function to get the wall-clock time in seconds.
+ */
+static double getTime() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + 1e-6 * now.tv_usec;
+}
+
+double BuildControl::getElapsed() const {
+	return getTime() - start;
+}
+
+/**
+ * Mark a build as running before it is handed to another thread, so that a
+ * cancellation in the meantime is not lost when the build begins.
+ */
+void BuildControl::arm() {
+	start = getTime();
+	rowsDone = 0;
+	rowsTotal = 0;
+	elementsDone = 0;
+	elementsTotal = 0;
+	entries = 0;
+	nextReport = 0;
+	usageKept = false;
+	exceeded = -1;
+	stage = "basis";
+	status = BUILD_RUNNING;
+	armed = true;
+}
+
+/**
+ * Set the amount of work at the start of a build, and mark the build as
+ * running unless it was armed beforehand.
+ *
+ * Arguments:
+ * @param rowsTotal - the number of rows this process will generate
+ * @param elementsTotal - the number of matrix elements in those rows
+ */
+void BuildControl::begin(const long long rowsTotal,
+		const long long elementsTotal) {
+	if (!armed.exchange(false)) {
+		arm();
+		armed = false;
+	}
+	this->rowsTotal = rowsTotal;
+	this->elementsTotal = elementsTotal;
+}
+
+void BuildControl::setStage(const char *stage) {
+	this->stage = stage;
+}
+
+void BuildControl::addEntries(const long long n) {
+	entries.fetch_add(n, memory_order_relaxed);
+}
+
+/**
+ * Account for a finished row and check the budget. The callback, if any,
+ * is invoked by the thread that crosses the next reporting threshold.
+ *
+ * Arguments:
+ * @param elements - the number of matrix elements in the row
+ *
+ * Returns false if the build should stop.
+ */
+bool BuildControl::rowDone(const long long elements) {
+	++rowsDone;
+	long long done = elementsDone.fetch_add(elements) + elements;
+	if (checkMemory() && budget.seconds > 0 && getElapsed() > budget.seconds) {
+		stop(BUILD_OUT_OF_TIME);
+	}
+	if (callback != NULL) {
+		long long threshold = nextReport;
+		long long step = elementsTotal / PROGRESS_REPORTS + 1;
+		if (done >= threshold
+				&& nextReport.compare_exchange_strong(threshold, done + step)) {
+			callback(getProgress(), callbackData);
+		}
+	}
+	return !isStopped();
+}
+
+bool BuildControl::isStopped() const {
+	return status.load(memory_order_relaxed) != BUILD_RUNNING;
+}
+
+/**
+ * Stop a running build for the given reason. Only the first reason is
+ * kept, along with the memory usage at that moment, since a stopped build
+ * releases its structures. Returns false if the build was not running.
+ */
+bool BuildControl::stop(const BuildStatus reason) {
+	int running = BUILD_RUNNING;
+	if (!status.compare_exchange_strong(running, reason)) {
+		return false;
+	}
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		stopUsage[i].store(usage[i].load(memory_order_relaxed),
+				memory_order_relaxed);
+	}
+	usageKept.store(true, memory_order_release);
+	return true;
+}
+
+void BuildControl::finish(const BuildStatus finalStatus) {
+	status = finalStatus;
+	stage = "done";
+	if (callback != NULL) {
+		callback(getProgress(), callbackData);
+	}
+}
+
+BuildStatus BuildControl::getStatus() const {
+	return (BuildStatus) status.load();
+}
+
+BuildProgress BuildControl::getProgress() const {
+	BuildProgress progress;
+	progress.status = getStatus();
+	progress.stage = stage;
+	progress.rowsDone = rowsDone;
+	progress.rowsTotal = rowsTotal;
+	progress.entries = entries;
+	progress.bytes = getMemoryUsage().getTotal();
+	progress.elapsed = getElapsed();
+	progress.remaining = -1;
+	progress.exceeded = getExceeded();
+	long long done = elementsDone, total = elementsTotal;
+	if (progress.status != BUILD_RUNNING) {
+		progress.remaining = 0;
+	} else if (done > 0 && total > 0) {
+		progress.remaining = progress.elapsed * (total - done) / done;
+	}
+	return progress;
+}
+
+void BuildControl::setUsage(const MemoryStructure structure,
+		const size_t bytes) {
+	usage[structure].store(bytes, memory_order_relaxed);
+}
+
+/**
+ * Returns the bytes held by each structure, or after a stopped build the
+ * bytes held when it stopped.
+ */
+MemoryUsage BuildControl::getMemoryUsage() const {
+	const atomic<size_t> *source =
+			usageKept.load(memory_order_acquire) ? stopUsage : usage;
+	MemoryUsage memory;
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		memory.bytes[i] = source[i].load(memory_order_relaxed);
+	}
+	return memory;
+}
+
+/**
+ * Returns the structure that breaks the memory budget, or -1 if the budget
+ * holds. A structure over its own share is named first; if only the total
+ * is over, the largest structure is named.
+ */
+int BuildControl::findExceeded() const {
+	if (budget.bytes == 0) {
+		return -1;
+	}
+	MemoryUsage memory = getMemoryUsage();
+	int largest = 0;
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		if (budget.shares[i] > 0
+				&& memory.bytes[i] > budget.shares[i] * budget.bytes) {
+			return i;
+		}
+		if (memory.bytes[i] > memory.bytes[largest]) {
+			largest = i;
+		}
+	}
+	return memory.getTotal() > budget.bytes ? largest : -1;
+}
+
+/**
+ * Returns the structure that broke the memory budget of the current or
+ * last build, or -1 if none did.
+ */
+int BuildControl::getExceeded() const {
+	return exceeded;
+}
+
+/**
+ * Stop the build if the memory budget is broken, and remember the
+ * structure to blame. Returns false if the build is over budget.
+ */
+bool BuildControl::checkMemory() {
+	int structure = findExceeded();
+	if (structure < 0) {
+		return true;
+	}
+	if (stop(BUILD_OUT_OF_MEMORY)) {
+		exceeded = structure;
+	}
+	return false;
+}
+
+/**
+ * Write the bytes held by each structure against its share of the budget,
+ * marking the structure that broke it.
+ */
+void BuildControl::writeMemoryReport(ostream &out) const {
+	MemoryUsage memory = getMemoryUsage();
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		out << setw(22) << getStructureName((MemoryStructure) i) << ": "
+				<< setw(14) << memory.bytes[i] << " bytes";
+		if (budget.shares[i] > 0) {
+			out << " of " << (size_t) (budget.shares[i] * budget.bytes);
+		}
+		if (i == exceeded) {
+			out << "  <- over budget";
+		}
+		out << "\n";
+	}
+	out << setw(22) << "total" << ": " << setw(14) << memory.getTotal()
+			<< " bytes";
+	if (budget.bytes > 0) {
+		out << " of " << budget.bytes;
+	}
+	out << endl;
+}
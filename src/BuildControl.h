@@ -0,0 +1,159 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+#ifndef BUILD_CONTROL
+#define BUILD_CONTROL
+
+using namespace std;
+
+enum BuildStatus {
+	BUILD_RUNNING,
+	BUILD_DONE,
+	BUILD_CANCELLED,
+	BUILD_OUT_OF_TIME,
+	BUILD_OUT_OF_MEMORY,
+	BUILD_INVALID
+};
+
+/**
+ * The data structures of a relaxation whose memory is accounted for.
+ */
+enum MemoryStructure {
+	MEMORY_CONSTRAINTS,
+	MEMORY_DICTIONARY,
+	MEMORY_OBJECTIVE,
+	MEMORY_BASIS,
+	MEMORY_VARIABLES,
+	N_MEMORY_STRUCTURES
+};
+
+const char *getStructureName(const MemoryStructure structure);
+
+/**
+ * Bytes held by each structure of a relaxation in this process.
+ */
+struct MemoryUsage {
+
+	size_t bytes[N_MEMORY_STRUCTURES];
+
+	size_t getTotal() const;
+};
+
+/**
+ * Limits of a relaxation build. A zero limit means no limit. The memory
+ * limit applies to the total of the accounted structures, and a structure
+ * can further be held to a share of it, given as a fraction.
+ */
+struct BuildBudget {
+
+	double seconds;
+	size_t bytes;
+	double shares[N_MEMORY_STRUCTURES];
+
+	BuildBudget() :
+			seconds(0), bytes(0) {
+		for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+			shares[i] = 0;
+		}
+	}
+};
+
+/**
+ * A snapshot of the progress of a relaxation build. Rows count the rows of
+ * the moment and localizing matrices generated by this process, bytes is
+ * the total memory accounted for, and the estimate of the remaining time in
+ * seconds is negative until there is progress to extrapolate from. If the
+ * build broke the memory budget, exceeded is the MemoryStructure to blame,
+ * otherwise it is -1.
+ */
+struct BuildProgress {
+
+	BuildStatus status;
+	const char *stage;
+	long long rowsDone;
+	long long rowsTotal;
+	long long entries;
+	size_t bytes;
+	double elapsed;
+	double remaining;
+	int exceeded;
+};
+
+const char *getStatusName(const BuildStatus status);
+
+typedef void (*ProgressCallback)(const BuildProgress &progress, void *data);
+
+/**
+ * Progress counters, cancellation flag and budget of a relaxation build.
+ * The counters are updated by the threads of the build and can be read
+ * from any other thread. Work is measured in matrix elements, so that
+ * rows of different lengths are weighted properly in the estimate.
+ */
+class BuildControl {
+
+private:
+	atomic<int> status;
+	atomic<const char *> stage;
+	atomic<long long> rowsDone;
+	atomic<long long> rowsTotal;
+	atomic<long long> elementsDone;
+	atomic<long long> elementsTotal;
+	atomic<long long> entries;
+	atomic<long long> nextReport;
+	atomic<size_t> usage[N_MEMORY_STRUCTURES];
+	atomic<size_t> stopUsage[N_MEMORY_STRUCTURES];
+	atomic<bool> usageKept;
+	atomic<int> exceeded;
+	atomic<bool> armed;
+	atomic<double> start;
+	BuildBudget budget;
+	ProgressCallback callback;
+	void *callbackData;
+
+	double getElapsed() const;
+
+public:
+	BuildControl();
+	void setBudget(const BuildBudget &budget);
+	void setCallback(ProgressCallback callback, void *data);
+	void arm();
+	void begin(const long long rowsTotal, const long long elementsTotal);
+	void setStage(const char *stage);
+	void addEntries(const long long n);
+	bool rowDone(const long long elements);
+	bool isStopped() const;
+	bool stop(const BuildStatus reason);
+	void finish(const BuildStatus finalStatus);
+	BuildStatus getStatus() const;
+	BuildProgress getProgress() const;
+	void setUsage(const MemoryStructure structure, const size_t bytes);
+	MemoryUsage getMemoryUsage() const;
+	int findExceeded() const;
+	int getExceeded() const;
+	bool checkMemory();
+	void writeMemoryReport(ostream &out) const;
+};
+
+#endif
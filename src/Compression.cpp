@@ -0,0 +1,64 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "Compression.h"
+
+// Window bits of deflate that ask for a gzip wrapper
+#define GZIP_WINDOW_BITS (15 + 16)
+// SDPA text is repetitive enough that the fastest level already compresses
+// it about four times, at little more than the cost of writing it plain
+#define GZIP_LEVEL 1
+
+/**
+ * Compress a piece of text as a complete gzip member and append it to the
+ * output. Members compressed independently can be concatenated, and the
+ * result is still a single valid gzip stream.
+ *
+ * Returns false if compression failed or zlib is not available.
+ */
+bool gzipCompress(const string &input, string &output) {
+#ifdef HAVE_ZLIB
+	z_stream stream;
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+	if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED,
+			GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return false;
+	}
+	size_t start = output.size();
+	// The gzip wrapper adds 18 bytes to the bound of a raw stream
+	output.resize(start + deflateBound(&stream, input.size()) + 18);
+	stream.next_in = (Bytef *) input.data();
+	stream.avail_in = input.size();
+	stream.next_out = (Bytef *) &output[start];
+	stream.avail_out = output.size() - start;
+	int result = deflate(&stream, Z_FINISH);
+	output.resize(start + stream.total_out);
+	deflateEnd(&stream);
+	return result == Z_STREAM_END;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,326 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cstring>
+#include "MonomialTable.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_SIZE 16
+#define CTRL_EMPTY 0x80
+
+/**
+ * Returns a bit mask of the slots in a group whose control byte matches.
+ */
+static inline unsigned int matchByte(const unsigned char *group,
+		const unsigned char byte) {
+#ifdef __SSE2__
+	__m128i c = _mm_loadu_si128((const __m128i *) group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8((char) byte)));
+#else
+	unsigned int mask = 0;
+	for (int i = 0; i < GROUP_SIZE; ++i) {
+		if (group[i] == byte) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+static inline bool keyEquals(const uint64_t *a, const uint64_t *b) {
+#ifdef __SSE2__
+	__m128i x = _mm_loadu_si128((const __m128i *) a);
+	__m128i y = _mm_loadu_si128((const __m128i *) b);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+#else
+	return a[0] == b[0] && a[1] == b[1];
+#endif
+}
+
+/**
+ * 64-bit finalizer of MurmurHash3 applied to both halves of a packed word.
+ */
+static inline size_t hashPacked(const uint64_t *key) {
+	uint64_t h = key[0] ^ (key[1] * 0x9E3779B97F4A7C15ULL);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return (size_t) h;
+}
+
+Word::Word() :
+		nLetters(0) {
+	packed[0] = 0;
+	packed[1] = 0;
+}
+
+/**
+ * Empty the word. The memory of a spilled word is kept for the next one.
+ */
+void Word::clear() {
+	packed[0] = 0;
+	packed[1] = 0;
+	letters.clear();
+	nLetters = 0;
+}
+
+/**
+ * Append a letter to the word. The letters are moved to the vector
+ * representation the first time the word stops fitting into 128 bits.
+ */
+void Word::push(const unsigned int letter) {
+	if (letters.empty() && nLetters < WORD_PACKED_LETTERS && letter <= 0xFFFF) {
+		packed[nLetters / 4] |= (uint64_t) letter << (16 * (nLetters % 4));
+	} else {
+		if (letters.empty()) {
+			for (unsigned int i = 0; i < nLetters; ++i) {
+				letters.push_back((packed[i / 4] >> (16 * (i % 4))) & 0xFFFF);
+			}
+			packed[0] = 0;
+			packed[1] = 0;
+		}
+		letters.push_back(letter);
+	}
+	++nLetters;
+}
+
+unsigned int Word::length() const {
+	return nLetters;
+}
+
+unsigned int Word::operator[](const unsigned int i) const {
+	if (!letters.empty()) {
+		return letters[i];
+	}
+	return (packed[i / 4] >> (16 * (i % 4))) & 0xFFFF;
+}
+
+bool Word::isPacked() const {
+	return letters.empty();
+}
+
+bool Word::operator==(const Word &other) const {
+	return nLetters == other.nLetters && packed[0] == other.packed[0]
+			&& packed[1] == other.packed[1] && letters == other.letters;
+}
+
+size_t hashWord::operator()(const Word &word) const {
+	size_t h = hashPacked(word.packed);
+	for (vector<unsigned int>::const_iterator i = word.letters.begin();
+			i != word.letters.end(); ++i) {
+		h ^= *i + 0x9E3779B9 + (h << 6) + (h >> 2);
+	}
+	return h;
+}
+
+MonomialTable::MonomialTable() :
+		ctrl(NULL), slots(NULL), nGroups(0), nPacked(0), growthLimit(0),
+		overflowLetters(0) {
+}
+
+MonomialTable::~MonomialTable() {
+	delete[] ctrl;
+	delete[] slots;
+}
+
+void MonomialTable::allocate(const size_t groups) {
+	nGroups = groups;
+	ctrl = new unsigned char[nGroups * GROUP_SIZE];
+	memset(ctrl, CTRL_EMPTY, nGroups * GROUP_SIZE);
+	slots = new Slot[nGroups * GROUP_SIZE];
+	// Keep the load factor below 7/8 so that probing always meets an empty slot
+	growthLimit = nGroups * GROUP_SIZE / 8 * 7;
+}
+
+void MonomialTable::rehash(const size_t groups) {
+	unsigned char *oldCtrl = ctrl;
+	Slot *oldSlots = slots;
+	size_t oldCapacity = nGroups * GROUP_SIZE;
+	allocate(groups);
+	nPacked = 0;
+	for (size_t i = 0; i < oldCapacity; ++i) {
+		if (oldCtrl[i] != CTRL_EMPTY) {
+			insertNew(oldSlots[i].key, hashPacked(oldSlots[i].key),
+					oldSlots[i].index);
+		}
+	}
+	delete[] oldCtrl;
+	delete[] oldSlots;
+}
+
+/**
+ * Probe the groups in triangular order, comparing the low seven bits of the
+ * hash against a whole group of control bytes at once. A group that still
+ * has an empty slot terminates the search.
+ */
+MonomialTable::Slot *MonomialTable::findSlot(const uint64_t *key,
+		const size_t hash) const {
+	if (nGroups == 0) {
+		return NULL;
+	}
+	const unsigned char h2 = hash & 0x7F;
+	const size_t mask = nGroups - 1;
+	size_t group = (hash >> 7) & mask;
+	for (size_t step = 1; step <= nGroups; ++step) {
+		const unsigned char *c = ctrl + group * GROUP_SIZE;
+		unsigned int match = matchByte(c, h2);
+		while (match != 0) {
+			Slot *slot = slots + group * GROUP_SIZE + __builtin_ctz(match);
+			if (keyEquals(slot->key, key)) {
+				return slot;
+			}
+			match &= match - 1;
+		}
+		if (matchByte(c, CTRL_EMPTY) != 0) {
+			return NULL;
+		}
+		group = (group + step) & mask;
+	}
+	return NULL;
+}
+
+void MonomialTable::insertNew(const uint64_t *key, const size_t hash,
+		const Index index) {
+	const size_t mask = nGroups - 1;
+	size_t group = (hash >> 7) & mask;
+	for (size_t step = 1;; ++step) {
+		unsigned int empty = matchByte(ctrl + group * GROUP_SIZE, CTRL_EMPTY);
+		if (empty != 0) {
+			size_t i = group * GROUP_SIZE + __builtin_ctz(empty);
+			ctrl[i] = hash & 0x7F;
+			slots[i].key[0] = key[0];
+			slots[i].key[1] = key[1];
+			slots[i].index = index;
+			++nPacked;
+			return;
+		}
+		group = (group + step) & mask;
+	}
+}
+
+/**
+ * Helper function to find the number of groups that hold the expected
+ * number of packed words without rehashing.
+ */
+static size_t getGroups(const size_t expected) {
+	size_t groups = 1;
+	while (groups * GROUP_SIZE / 8 * 7 < expected) {
+		groups *= 2;
+	}
+	return groups;
+}
+
+/**
+ * Preallocate the table for the expected number of moments, so that no
+ * rehashing happens while the moment matrix is generated.
+ */
+void MonomialTable::reserve(const size_t expected) {
+	size_t groups = getGroups(expected);
+	if (groups > nGroups) {
+		rehash(groups);
+	}
+}
+
+void MonomialTable::clear() {
+	delete[] ctrl;
+	delete[] slots;
+	ctrl = NULL;
+	slots = NULL;
+	nGroups = 0;
+	nPacked = 0;
+	growthLimit = 0;
+	overflow.clear();
+	overflowLetters = 0;
+}
+
+size_t MonomialTable::size() const {
+	return nPacked + overflow.size();
+}
+
+/**
+ * Returns the memory held by the table. The nodes of the overflow map are
+ * estimated, as the standard library does not expose their size.
+ */
+size_t MonomialTable::bytes() const {
+	return nGroups * GROUP_SIZE * (1 + sizeof(Slot))
+			+ overflow.bucket_count() * sizeof(void *)
+			+ overflow.size()
+					* (sizeof(pair<const Word, Index>) + 2 * sizeof(void *))
+			+ overflowLetters * sizeof(unsigned int);
+}
+
+/**
+ * Returns the memory a table reserved for the expected number of words
+ * would hold, before any word spills over.
+ */
+size_t MonomialTable::getReservedBytes(const size_t expected) {
+	return getGroups(expected) * GROUP_SIZE * (1 + sizeof(Slot));
+}
+
+/**
+ * Returns the index of a word, or NULL if it is not in the table. Unlike
+ * operator[] on a map, the lookup never inserts.
+ */
+const Index *MonomialTable::find(const Word &word) const {
+	if (!word.isPacked()) {
+		unordered_map<Word, Index, hashWord>::const_iterator i = overflow.find(
+				word);
+		return i == overflow.end() ? NULL : &i->second;
+	}
+	Slot *slot = findSlot(word.packed, hashPacked(word.packed));
+	return slot == NULL ? NULL : &slot->index;
+}
+
+Index *MonomialTable::find(const Word &word) {
+	return const_cast<Index *>(static_cast<const MonomialTable *>(this)->find(
+			word));
+}
+
+/**
+ * Insert a word with an index unless it is already present.
+ *
+ * Returns the index stored in the table and whether the word was inserted.
+ */
+pair<Index, bool> MonomialTable::insert(const Word &word, const Index index) {
+	if (!word.isPacked()) {
+		pair<unordered_map<Word, Index, hashWord>::iterator, bool> result =
+				overflow.insert(make_pair(word, index));
+		if (result.second) {
+			overflowLetters += word.length();
+		}
+		return make_pair(result.first->second, result.second);
+	}
+	size_t hash = hashPacked(word.packed);
+	Slot *slot = findSlot(word.packed, hash);
+	if (slot != NULL) {
+		return make_pair(slot->index, false);
+	}
+	if (nPacked >= growthLimit) {
+		rehash(nGroups == 0 ? 1 : 2 * nGroups);
+	}
+	insertNew(word.packed, hash, index);
+	return make_pair(index, true);
+}
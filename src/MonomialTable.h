@@ -0,0 +1,108 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef MONOMIAL_TABLE
+#define MONOMIAL_TABLE
+
+using namespace std;
+
+typedef pair<int, int> Index;
+
+/**
+ * A word over the noncommutative variables. Letter l stands for the
+ * variable with index l-1, so that a zero letter marks an unused slot.
+ * Words of up to WORD_PACKED_LETTERS letters below 2^16 are packed into
+ * 128 bits, longer words spill over into a plain vector of letters.
+ */
+#define WORD_PACKED_LETTERS 8
+
+class Word {
+
+public:
+	uint64_t packed[2];
+	vector<unsigned int> letters;
+
+	Word();
+	void clear();
+	void push(const unsigned int letter);
+	unsigned int length() const;
+	unsigned int operator[](const unsigned int i) const;
+	bool isPacked() const;
+	bool operator==(const Word &other) const;
+
+private:
+	unsigned int nLetters;
+};
+
+struct hashWord {
+	size_t operator()(const Word &word) const;
+};
+
+/**
+ * Flat open-addressing hash table mapping words to the (row, column)
+ * position where the corresponding moment was first seen. Packed words live
+ * in groups of 16 slots probed by a control byte per slot, words that do
+ * not fit 128 bits fall back to an unordered_map.
+ */
+class MonomialTable {
+
+private:
+	struct Slot {
+		uint64_t key[2];
+		Index index;
+	};
+
+	unsigned char *ctrl;
+	Slot *slots;
+	size_t nGroups;
+	size_t nPacked;
+	size_t growthLimit;
+	unordered_map<Word, Index, hashWord> overflow;
+	size_t overflowLetters;
+
+	void allocate(const size_t groups);
+	void rehash(const size_t groups);
+	Slot *findSlot(const uint64_t *key, const size_t hash) const;
+	void insertNew(const uint64_t *key, const size_t hash, const Index index);
+
+public:
+	MonomialTable();
+	~MonomialTable();
+	// The table owns its arrays and is not copied
+	MonomialTable(const MonomialTable &) = delete;
+	MonomialTable &operator=(const MonomialTable &) = delete;
+	void reserve(const size_t expected);
+	void clear();
+	size_t size() const;
+	size_t bytes() const;
+	static size_t getReservedBytes(const size_t expected);
+	const Index *find(const Word &word) const;
+	Index *find(const Word &word);
+	pair<Index, bool> insert(const Word &word, const Index index);
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "RelaxationBuild.h"
+
+/**
+ * Start building a relaxation in the background. The budget and progress
+ * callback set on the relaxation apply.
+ *
+ * Arguments:
+ * @param relaxation - the relaxation to build, owned by the caller
+ * @param variables - the noncommutative variables
+ * @param problem - the objective function and the constraints, copied
+ * @param order - the order of the relaxation
+ */
+RelaxationBuild::RelaxationBuild(SdpRelaxation *relaxation,
+		const Symbolic variables, const SparseProblem &problem,
+		const short int order) :
+		relaxation(relaxation) {
+	relaxation->control.arm();
+	worker = thread([=]() {
+		relaxation->getRelaxation(variables, problem, order);
+	});
+}
+
+/**
+ * A build that is still running when the handle goes away is cancelled.
+ */
+RelaxationBuild::~RelaxationBuild() {
+	if (worker.joinable()) {
+		relaxation->cancel();
+		worker.join();
+	}
+}
+
+BuildProgress RelaxationBuild::getProgress() const {
+	return relaxation->getProgress();
+}
+
+void RelaxationBuild::cancel() {
+	relaxation->cancel();
+}
+
+/**
+ * Wait for the build to finish. Returns how it finished.
+ */
+BuildStatus RelaxationBuild::wait() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+	return relaxation->getStatus();
+}
@@ -0,0 +1,54 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <thread>
+#include "SdpRelaxation.h"
+
+#ifndef RELAXATION_BUILD
+#define RELAXATION_BUILD
+
+using namespace std;
+
+/**
+ * Handle of a relaxation built in the background. The build runs on a
+ * thread of its own, which spreads the work over the OpenMP threads just
+ * like a blocking build. The relaxation must not be touched until the
+ * build has been waited for, apart from the progress, status and cancel
+ * calls. If the relaxation is distributed with setCommunicator, every
+ * rank of the communicator starts its own build, and MPI must be
+ * initialized with at least MPI_THREAD_SERIALIZED.
+ */
+class RelaxationBuild {
+
+private:
+	SdpRelaxation *relaxation;
+	thread worker;
+
+public:
+	RelaxationBuild(SdpRelaxation *relaxation, const Symbolic variables,
+			const SparseProblem &problem, const short int order);
+	~RelaxationBuild();
+	BuildProgress getProgress() const;
+	void cancel();
+	BuildStatus wait();
+};
+
+#endif
@@ -19,25 +19,84 @@
  *
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "SdpRelaxation.h"
 
+// Estimated heap memory of a factor of a symbolic monomial
+#define SYMBOLIC_FACTOR_BYTES 64
+// Entries per independently compressed chunk of the output, and chunks
+// compressed per thread before they are written
+#define SDPA_CHUNK_ENTRIES 65536
+#define SDPA_CHUNKS_PER_THREAD 4
+// Bytes of the header buffered before they are written
+#define SDPA_HEADER_PIECE_BYTES (1 << 20)
+// Matrix elements generated in parallel before they are merged in the
+// serial order
+#define BLOCK_ELEMENTS (1 << 16)
+
 using namespace std;
 
 
 SdpRelaxation::SdpRelaxation(
-		const unordered_map<Symbolic, Symbolic, hashMonomial> substitutions) :
-		substitutions(substitutions) {
+		const unordered_map<Symbolic, Symbolic, hashMonomial> substitutions,
+		const Algebra *algebra, const SymmetryGroup *symmetry) :
+		substitutions(substitutions), algebra(algebra), symmetry(symmetry),
+		basis(NULL), verbose(true), rank(0), nRanks(1), communicator(NULL),
+		nMonomials(0), nElements(0), nVariables(0), objFacVar(NULL),
+		blockBytes(0) {
 }
 
 SdpRelaxation::~SdpRelaxation() {
-	delete[] F;
+	delete[] objFacVar;
+#ifdef HAVE_MPI
+	delete static_cast<MPI_Comm *>(communicator);
+#endif
+}
+
+#ifdef HAVE_MPI
+/** Distribute the subsequent builds over the ranks of a communicator. Every
+ * rank of the communicator must then make the same calls to build and
+ * write the same relaxation, since they take part in collective
+ * operations on it. By default a relaxation is built by the calling
+ * process alone, also when MPI is initialized, so that ranks can build
+ * relaxations of their own.
+ *
+ * @param comm - the communicator, MPI_COMM_NULL to build alone again
+ */
+void SdpRelaxation::setCommunicator(MPI_Comm comm) {
+	delete static_cast<MPI_Comm *>(communicator);
+	communicator = NULL;
+	rank = 0;
+	nRanks = 1;
+	if (comm != MPI_COMM_NULL) {
+		communicator = new MPI_Comm(comm);
+		MPI_Comm_rank(comm, &rank);
+		MPI_Comm_size(comm, &nRanks);
+	}
+}
+
+/**
+ * Helper function to get the communicator of a distributed relaxation.
+ */
+static MPI_Comm getComm(const void *communicator) {
+	return *static_cast<const MPI_Comm *>(communicator);
 }
+#endif
 
 /** 
  * Helper function to remove monomials from the basis.
  */
 Symbolic SdpRelaxation::applySubstitution(Symbolic monomial) {
+	if (substitutions.empty()) {
+		return monomial;
+	}
 	Symbolic originalMonomial;
 	bool changed = true;
 	while (changed) {
@@ -57,6 +116,107 @@ Symbolic SdpRelaxation::applySubstitution(Symbolic monomial) {
 	return monomial;
 }
 
+/**
+ * Helper function to append the variable indices of a single factor of a
+ * monomial to a word. Returns false if the factor is not a power of a
+ * variable.
+ */
+static bool appendLetters(const Symbolic factor,
+		const unordered_map<Symbolic, unsigned int, hashMonomial> &letters,
+		vector<unsigned int> &word) {
+	Symbolic variable = factor;
+	int degree = 1;
+	if (factor.type() == typeid(Numeric)) {
+		return true;
+	} else if (factor.type() == typeid(Power)) {
+		CastPtr<const Power> p = factor;
+		variable = p->parameters.front();
+		degree = (int) p->parameters.back();
+	}
+	unordered_map<Symbolic, unsigned int, hashMonomial>::const_iterator letter =
+			letters.find(variable);
+	if (letter == letters.end()) {
+		return false;
+	}
+	word.insert(word.end(), degree, letter->second);
+	return true;
+}
+
+/**
+ * Translate a monomial to the word used as a key in the monomial
+ * dictionary. If an algebra is given, the word is brought to its normal
+ * form, and if a symmetry group is given, the word is replaced by the
+ * representative of its orbit. The coefficient of the monomial is dropped,
+ * only its sign is kept together with the sign of the normal ordering. A
+ * monomial that the substitutions reduced to zero is no moment at all: its
+ * sign is zero and its word must not be looked up.
+ *
+ * A monomial that is not a product of the variables, such as a sum left by
+ * a substitution rule, has no word. The build is then stopped with
+ * BUILD_INVALID, and the sign is zero.
+ *
+ * The word is built in place, in the letter buffer of the calling thread,
+ * so that a word that is reused does not allocate again.
+ */
+void SdpRelaxation::getWord(const Symbolic monomial, Word &word, int *sign) {
+	word.clear();
+	double coefficient = getCoefficient(monomial);
+	if (coefficient == 0) {
+		*sign = 0;
+		return;
+	}
+	vector<unsigned int> &indices = getScratch().indices;
+	indices.clear();
+	bool valid = true;
+	if (monomial.type() == typeid(Product)) {
+		CastPtr<const Product> product = monomial;
+		for (list<Symbolic>::const_iterator i = product->factors.begin();
+				valid && i != product->factors.end(); ++i) {
+			valid = appendLetters(*i, letters, indices);
+		}
+	} else {
+		valid = appendLetters(monomial, letters, indices);
+	}
+	if (!valid) {
+		if (control.stop(BUILD_INVALID)) {
+			cerr << "Not a monomial of the variables: " << monomial << endl;
+		}
+		*sign = 0;
+		return;
+	}
+	*sign = coefficient < 0 ? -1 : 1;
+	if (algebra != NULL) {
+		*sign *= algebra->normalOrder(indices);
+	}
+	if (symmetry != NULL) {
+		*sign *= symmetry->canonicalize(indices, algebra);
+	}
+	for (vector<unsigned int>::const_iterator i = indices.begin();
+			i != indices.end(); ++i) {
+		word.push(*i + 1);
+	}
+}
+
+
+/**
+ * Returns the buffers of the calling OpenMP thread.
+ */
+SdpRelaxation::Scratch &SdpRelaxation::getScratch() {
+#ifdef _OPENMP
+	return scratch[omp_get_thread_num()];
+#else
+	return scratch[0];
+#endif
+}
+
+/**
+ * Generate the set W_d of words (monomials) of length up to d over the
+ * variables. The basis depends on nothing else, so it can be shared by the
+ * relaxations of the same variables and order through setBasis.
+ *
+ * @param variables - the noncommutative variables
+ * @param degree - the maximum length of the words
+ */
 vector<Symbolic> SdpRelaxation::getNcMonomials(const Symbolic variables,
 		short int degree) {
 	list<Symbolic> ncMonomials;
@@ -83,6 +243,99 @@ vector<Symbolic> SdpRelaxation::getNcMonomials(const Symbolic variables,
 	return unique(ncMonomials);
 }
 
+/**
+ * Calculate the words of the (u,w) element of the moment matrix and of its
+ * transpose.
+ */
+void SdpRelaxation::getMomentWords(const vector<Symbolic> &monomials,
+		const int row, const int column, Word &word, int *sign,
+		Word &word_dagger, int *sign_dagger) {
+  // Calculate the monomial u*v
+	Symbolic monomial = conjugate(monomials[row]) * monomials[column];
+  // Apply substitutions if any
+	monomial = applySubstitution(monomial);
+	getWord(monomial, word, sign);
+	if (row != column) {
+    // Special care must be taken so that the resulting
+    // constraint matrices are symmetric, not just 
+    // Hermitian. The procedure is essentially the same as 
+    // above.          
+		Symbolic monomial_dagger = conjugate(monomials[column]) * monomials[row];
+		monomial_dagger = applySubstitution(monomial_dagger);
+		getWord(monomial_dagger, word_dagger, sign_dagger);
+	}
+}
+
+/**
+ * Push an entry to the constraint matrix of position k. A distributed
+ * relaxation keeps the entries of its own rows in a list with their
+ * positions instead of one list per position of the moment matrix.
+ */
+void SdpRelaxation::pushEntry(const long long k, const Entry &entry) {
+	if (nRanks > 1) {
+		localEntries.push_back(make_pair(k, entry));
+	} else {
+		F[k].push_back(entry);
+	}
+}
+
+/**
+ * Push the (u,w) element of the moment matrix to the F structure, given the
+ * positions where the moments of the element and of its transpose were
+ * first seen, and the signs of the element and its transpose relative to
+ * those moments. A zero sign stands for a monomial that is zero, which
+ * contributes no entry.
+ */
+void SdpRelaxation::pushMomentEntries(const int blockIndex, const int row,
+		const int column, const Index index, const int sign,
+		const Index index_dagger, const int sign_dagger) {
+	Entry entry;
+	entry.blockIndex = blockIndex;
+	entry.row = row + 1;
+	entry.column = column + 1;
+	long long k = index2linear(index.first, index.second, nMonomials);
+	if (row == column) {
+		if (sign != 0) {
+			entry.value = sign;
+			pushEntry(k, entry);
+			control.addEntries(1);
+		}
+		return;
+	}
+	long long k_dagger = index2linear(index_dagger.first, index_dagger.second,
+			nMonomials);
+	if (sign != 0 && sign_dagger != 0 && k_dagger == k) {
+		entry.value = 0.5 * (sign + sign_dagger);
+		if (entry.value != 0) {
+			pushEntry(k, entry);
+			control.addEntries(1);
+		}
+		return;
+	}
+	if (sign_dagger != 0) {
+		entry.value = 0.5 * sign_dagger;
+		pushEntry(k_dagger, entry);
+		control.addEntries(1);
+	}
+	if (sign != 0) {
+		entry.value = 0.5 * sign;
+		pushEntry(k, entry);
+		control.addEntries(1);
+	}
+}
+
+/**
+ * Helper function to count the bytes held by a buffer of words, including
+ * the letters of the words that do not fit the packed form.
+ */
+static size_t getBytes(const vector<Word> &words) {
+	size_t bytes = words.capacity() * sizeof(Word);
+	for (size_t i = 0; i < words.size(); ++i) {
+		bytes += words[i].letters.capacity() * sizeof(unsigned int);
+	}
+	return bytes;
+}
+
 /**
  * Generate the moment matrix of monomials
  * 
@@ -91,144 +344,568 @@ vector<Symbolic> SdpRelaxation::getNcMonomials(const Symbolic variables,
  * @param block_index - current block index in the constraints matrices of the
  *                      SDP relaxation
  */
-void SdpRelaxation::generateMomentMatrix(const vector<Symbolic> monomials,
+void SdpRelaxation::generateMomentMatrix(const vector<Symbolic> &monomials,
 		int *blockIndex) {
 	Entry entry;
 	*blockIndex = 1;
 	int nEq = 1;
-	// Defining top left corner of momentum matrix
-	entry.blockIndex = *blockIndex;
-	entry.row = nEq;
-	entry.column = nEq;
-	entry.value = 1;
-	F[0].push_back(entry);
-	F[index2linear(0, 0, nMonomials)].push_back(entry);
-	++nEq;
-	entry.row = nEq;
-	entry.column = nEq;
-	entry.value = -1;
-	F[0].push_back(entry);
-	F[index2linear(0, 0, nMonomials)].push_back(entry);
+	// Defining top left corner of momentum matrix. When the relaxation is
+	// distributed, it belongs to the first rank.
+	if (rank == 0) {
+		entry.blockIndex = *blockIndex;
+		entry.row = nEq;
+		entry.column = nEq;
+		entry.value = 1;
+		pushEntry(0, entry);
+		pushEntry(index2linear(0, 0, nMonomials), entry);
+		++nEq;
+		entry.row = nEq;
+		entry.column = nEq;
+		entry.value = -1;
+		pushEntry(0, entry);
+		pushEntry(index2linear(0, 0, nMonomials), entry);
+	} else {
+		++nEq;
+	}
 	blockStruct.push_back(-nEq);
   ++(*blockIndex);
-  entry.blockIndex = *blockIndex;
-	Index index;
-	Symbolic monomial, monomial_dagger;
-  int k, k_dagger;
-  float value;
-  // Generating the rest of the matrix.
-  // This is potentially done in parallel, albeit the symbolic library used is 
-  // not thread-safe.
-	#pragma omp parallel default(shared) private(index, entry, k, k_dagger, monomial, monomial_dagger, value)
-	{
-	#pragma omp for schedule(runtime)
-  // We process (u,w) elements of the matrix
-	for (int row = 0; row < nMonomials; ++row) {
-		for (int column = row; column < nMonomials; ++column) {
-      // Calculate the monomial u*v
-			monomial = conjugate(monomials[row]) * monomials[column];
-      // Apply substitutions if any
-			monomial = applySubstitution(monomial);
-			if (getCoefficient(monomial) < 0) {
-				monomial = -monomial;
-			}
-      // Look up the index of the monomial in the dictionary built so far
-			index = monomialDictionary[monomial];
-			#pragma omp critical(update)
-			{
-        // Have we seen this monomial before?
-        if (index.first == 0 && index.second == 0) {
-          // If not, we add a new entry to the monomial dictionary.
-          index.first = row;
-          index.second = column;
-          monomialDictionary[monomial] = index;
-          k = index2linear(row, column, nMonomials);
-        } else {
-          // If yes, then we improve sparsity by reusing the 
-          // previous variable to denote this entry in the matrix
-          k = index2linear(index.first, index.second, nMonomials);
-        }
-        if (row == column) {
-          value = 1;
-        } else {
-          // Special care must be taken so that the resulting
-          // constraint matrices are symmetric, not just 
-          // Hermitian. The procedure is essentially the same as 
-          // above.          
-          value = 0.5;
-          monomial_dagger = conjugate(monomials[column]) * monomials[row];
-			    monomial_dagger = applySubstitution(monomial_dagger);
-          if (getCoefficient(monomial_dagger) < 0) {
-            monomial_dagger = -monomial_dagger;
-          }
-          index = monomialDictionary[monomial_dagger];
-          if (index.first == 0 && index.second == 0) {
-            index.first = column;
-            index.second = row;
-            monomialDictionary[monomial] = index;
-            k_dagger = index2linear(column, row, nMonomials);
-          } else {
-            k_dagger = index2linear(index.first, index.second, nMonomials);
-          }
-          if (k_dagger == k) {
-            value = 1;
-          } else {
-            entry.row = row + 1;
-            entry.column = column + 1;
-            entry.value = value;
-            F[k_dagger].push_back(entry);
-          }
-        }
-        entry.row = row + 1;
-        entry.column = column + 1;
-        entry.value = value;
-        F[k].push_back(entry);
-			}
-		}
-	}
-	}
-	#pragma omp barrier
+  if (nRanks > 1) {
+    generateDistributedMomentMatrix(monomials, *blockIndex);
+  } else {
+  // Generating the rest of the matrix a block of rows at a time. The words
+  // of the (u,w) elements of a block are calculated in parallel, and then
+  // looked up and pushed in the serial order, so that neither the position
+  // representing a moment nor the order of the entries depends on the
+  // number of threads or the schedule.
+	vector<Word> words, words_dagger;
+	vector<int> signs, signs_dagger;
+	vector<size_t> offsets;
+	Index index, index_dagger;
+	for (int first = 0; first < nMonomials && !control.isStopped();) {
+		int last = first;
+		size_t nPairs = 0;
+		offsets.clear();
+		while (last < nMonomials && nPairs < BLOCK_ELEMENTS) {
+			offsets.push_back(nPairs);
+			nPairs += nMonomials - last;
+			++last;
+		}
+		words.resize(nPairs);
+		words_dagger.resize(nPairs);
+		signs.resize(nPairs);
+		signs_dagger.resize(nPairs);
+		#pragma omp parallel for schedule(runtime)
+		for (int row = first; row < last; ++row) {
+			// Iterations cannot be abandoned in a parallel loop, so the
+			// remaining rows are skipped once the build is stopped
+			if (control.isStopped()) {
+				continue;
+			}
+			for (int column = row; column < nMonomials; ++column) {
+				size_t p = offsets[row - first] + column - row;
+				getMomentWords(monomials, row, column, words[p], &signs[p],
+						words_dagger[p], &signs_dagger[p]);
+			}
+			rowDone(nMonomials - row);
+		}
+		for (int row = first; row < last && !control.isStopped(); ++row) {
+			for (int column = row; column < nMonomials; ++column) {
+				size_t p = offsets[row - first] + column - row;
+        // Look up the index of the monomial in the dictionary built so far.
+        // If we have not seen this monomial before, it is added with the
+        // current position; if we have, we improve sparsity by reusing the
+        // previous variable to denote this entry in the matrix. Zero
+        // monomials are no moments and stay out of the dictionary.
+				if (signs[p] != 0) {
+					index = monomialDictionary.insert(words[p],
+							Index(row, column)).first;
+				}
+				if (row != column && signs_dagger[p] != 0) {
+					index_dagger = monomialDictionary.insert(words_dagger[p],
+							Index(column, row)).first;
+				}
+				pushMomentEntries(*blockIndex, row, column, index, signs[p],
+						index_dagger, signs_dagger[p]);
+			}
+		}
+		blockDone(getBytes(words) + getBytes(words_dagger)
+				+ 2 * signs.capacity() * sizeof(int));
+		first = last;
+	}
+  }
   blockStruct.push_back(nMonomials);
   ++(*blockIndex);
 }
 
-/* 
- * Calculate the sparse vector representation of a polynomial
- * and pushes it to the F structure.
+/**
+ * Serialize a word as a length-prefixed run of integers.
  */
-void SdpRelaxation::pushFacVarSparse(const Symbolic polynomial,
-		const int blockIndex, const int i, const int j) {
-	list<Symbolic> factors;
-  // Preprocess the polynomial for uniform handling later
-	if (polynomial.type() == typeid(Sum)) {
-		factors = CastPtr<const Sum>(polynomial)->summands;
-	} else {
-		factors.push_back(polynomial);
+static void packWord(const Word &word, vector<unsigned int> &buffer) {
+	buffer.push_back(word.length());
+	for (unsigned int i = 0; i < word.length(); ++i) {
+		buffer.push_back(word[i]);
+	}
+}
+
+/**
+ * Returns the number of integers consumed.
+ */
+static size_t unpackWord(const unsigned int *buffer, Word &word) {
+	unsigned int length = buffer[0];
+	word.clear();
+	for (unsigned int i = 1; i <= length; ++i) {
+		word.push(buffer[i]);
+	}
+	return length + 1;
+}
+
+/**
+ * Returns the rank that owns a word in the distributed dictionary. The
+ * high bits of the hash are used, since the table of the owner picks its
+ * slots by the low bits.
+ */
+static int getOwner(const Word &word, const int nRanks) {
+	hashWord hash;
+	return ((uint64_t) hash(word) >> 32) % nRanks;
+}
+
+/**
+ * Helper function to send a list to every rank and receive the lists sent
+ * to this rank, one after the other in the order of the ranks. The number
+ * of elements received from each rank is returned in counts. Without MPI,
+ * the only list is the one a rank sends to itself.
+ *
+ * MPI counts and displacements are ints, so the lists are sent in pieces
+ * that keep the bytes of a call below INT_MAX, in as many calls as the
+ * longest list between two ranks needs.
+ */
+template<class T>
+static void exchangeLists(const vector<vector<T> > &outgoing,
+		vector<T> &incoming, vector<size_t> &counts, const void *communicator) {
+	int nRanks = outgoing.size();
+	counts.assign(nRanks, 0);
+#ifdef HAVE_MPI
+	if (nRanks > 1) {
+		MPI_Comm comm = getComm(communicator);
+		vector<unsigned long long> sendCounts(nRanks), recvCounts(nRanks);
+		for (int r = 0; r < nRanks; ++r) {
+			sendCounts[r] = outgoing[r].size();
+		}
+		MPI_Alltoall(sendCounts.data(), 1, MPI_UNSIGNED_LONG_LONG,
+				recvCounts.data(), 1, MPI_UNSIGNED_LONG_LONG, comm);
+		vector<size_t> recvOffsets(nRanks);
+		size_t nRecv = 0;
+		unsigned long long longest = 0;
+		for (int r = 0; r < nRanks; ++r) {
+			recvOffsets[r] = nRecv;
+			nRecv += recvCounts[r];
+			counts[r] = recvCounts[r];
+			longest = max(longest, max(sendCounts[r], recvCounts[r]));
+		}
+		incoming.resize(nRecv);
+		MPI_Allreduce(MPI_IN_PLACE, &longest, 1, MPI_UNSIGNED_LONG_LONG,
+				MPI_MAX, comm);
+		size_t piece = max((size_t) 1, INT_MAX / nRanks / sizeof(T));
+		vector<T> sendBuffer, recvBuffer;
+		vector<int> sendBytes(nRanks), sendOffsets(nRanks);
+		vector<int> recvBytes(nRanks), recvByteOffsets(nRanks);
+		for (size_t first = 0; first < longest; first += piece) {
+			sendBuffer.clear();
+			size_t nPiece = 0;
+			for (int r = 0; r < nRanks; ++r) {
+				size_t begin = min(first, outgoing[r].size());
+				size_t end = min(first + piece, outgoing[r].size());
+				sendOffsets[r] = sendBuffer.size() * sizeof(T);
+				sendBytes[r] = (end - begin) * sizeof(T);
+				sendBuffer.insert(sendBuffer.end(), outgoing[r].begin() + begin,
+						outgoing[r].begin() + end);
+				begin = min((unsigned long long) first, recvCounts[r]);
+				end = min((unsigned long long) first + piece, recvCounts[r]);
+				recvByteOffsets[r] = nPiece * sizeof(T);
+				recvBytes[r] = (end - begin) * sizeof(T);
+				nPiece += end - begin;
+			}
+			recvBuffer.resize(nPiece);
+			MPI_Alltoallv(sendBuffer.data(), sendBytes.data(), sendOffsets.data(),
+					MPI_BYTE, recvBuffer.data(), recvBytes.data(),
+					recvByteOffsets.data(), MPI_BYTE, comm);
+			for (int r = 0; r < nRanks; ++r) {
+				if (recvBytes[r] > 0) {
+					typename vector<T>::const_iterator received =
+							recvBuffer.begin() + recvByteOffsets[r] / sizeof(T);
+					copy(received, received + recvBytes[r] / sizeof(T),
+							incoming.begin() + recvOffsets[r] + first);
+				}
+			}
+		}
+		return;
+	}
+#endif
+	incoming = outgoing[0];
+	counts[0] = incoming.size();
+}
+
+/**
+ * Helper function to agree on the number of rounds of an exchange. Every
+ * rank takes part in every round, so the rounds are as many as the most
+ * any rank needs.
+ */
+static int agreeRounds(int rounds, const int nRanks,
+		const void *communicator) {
+#ifdef HAVE_MPI
+	if (nRanks > 1) {
+		MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_INT, MPI_MAX,
+				getComm(communicator));
+	}
+#endif
+	return rounds;
+}
+
+/**
+ * Tells whether the moment matrix element at position a is visited before
+ * the one at position b in the serial generation order: the (u,w) elements
+ * of the upper triangle in row-major order, each followed by its transpose.
+ */
+static bool precedes(const Index a, const Index b) {
+	int aRow = min(a.first, a.second), aColumn = max(a.first, a.second);
+	int bRow = min(b.first, b.second), bColumn = max(b.first, b.second);
+	if (aRow != bRow) {
+		return aRow < bRow;
+	}
+	if (aColumn != bColumn) {
+		return aColumn < bColumn;
+	}
+	return a.first <= a.second && b.first > b.second;
+}
+
+/**
+ * Helper function to record the word of an element of the moment matrix
+ * generated on this rank. A word seen for the first time on this rank gets
+ * the next local number, and it becomes a candidate for the dictionary with
+ * the position of the element. Returns the local number of the word plus
+ * one, times the sign of the element, or zero for a zero monomial.
+ */
+static int recordWord(const Word &word, const int sign, const Index index,
+		MonomialTable &seen, vector<Word> &seenWords,
+		vector<pair<Word, Index> > &candidates) {
+	if (sign == 0) {
+		return 0;
+	}
+	pair<Index, bool> result = seen.insert(word, Index(seenWords.size(), 0));
+	if (result.second) {
+		seenWords.push_back(word);
+		candidates.push_back(make_pair(word, index));
+	}
+	return sign * (result.first.first + 1);
+}
+
+/**
+ * Generate the moment matrix with its rows distributed cyclically over the
+ * MPI ranks, a block of rows at a time. The words of the elements of a
+ * block are calculated in parallel, and the words seen for the first time
+ * on this rank are sent to their owners in the dictionary, which is divided
+ * among the ranks. Once every rank is done, the ranks look up the position
+ * where each of their words was first seen in the serial order, and push
+ * the entries of their rows. The numbering of the variables is the same as
+ * that of a single-threaded run.
+ *
+ * Every element keeps only the local number of its words, and the words
+ * are kept once per rank, so the memory of a rank grows with its share of
+ * the matrix.
+ */
+void SdpRelaxation::generateDistributedMomentMatrix(
+		const vector<Symbolic> &monomials, const int blockIndex) {
+	vector<int> rows;
+	for (int row = rank; row < nMonomials; row += nRanks) {
+		rows.push_back(row);
+	}
+	// The first local row of each block
+	vector<size_t> blocks(1, 0);
+	size_t nPairs = 0;
+	for (size_t i = 0; i < rows.size(); ++i) {
+		nPairs += nMonomials - rows[i];
+		if (nPairs >= BLOCK_ELEMENTS || i + 1 == rows.size()) {
+			blocks.push_back(i + 1);
+			nPairs = 0;
+		}
+	}
+	MonomialTable seen;
+	vector<Word> seenWords;
+	// Local number and sign of the word of every element and of its
+	// transpose, in the order of the elements
+	vector<int> moments, moments_dagger;
+	vector<Word> words, words_dagger;
+	vector<int> signs, signs_dagger;
+	vector<size_t> offsets;
+	vector<pair<Word, Index> > candidates;
+	int nRounds = agreeRounds(blocks.size() - 1, nRanks, communicator);
+	for (int round = 0; round < nRounds; ++round) {
+		candidates.clear();
+		if (round < (int) blocks.size() - 1 && !control.isStopped()) {
+			size_t first = blocks[round], last = blocks[round + 1];
+			offsets.clear();
+			nPairs = 0;
+			for (size_t i = first; i < last; ++i) {
+				offsets.push_back(nPairs);
+				nPairs += nMonomials - rows[i];
+			}
+			words.resize(nPairs);
+			words_dagger.resize(nPairs);
+			signs.resize(nPairs);
+			signs_dagger.resize(nPairs);
+			#pragma omp parallel for schedule(runtime)
+			for (int i = first; i < (int) last; ++i) {
+				if (control.isStopped()) {
+					continue;
+				}
+				for (int column = rows[i]; column < nMonomials; ++column) {
+					size_t p = offsets[i - first] + column - rows[i];
+					getMomentWords(monomials, rows[i], column, words[p], &signs[p],
+							words_dagger[p], &signs_dagger[p]);
+				}
+				rowDone(nMonomials - rows[i]);
+			}
+      // Since the rows are visited in increasing order, the first
+      // occurrence of a word on this rank is also the earliest one in the
+      // serial order
+			for (size_t i = first; i < last && !control.isStopped(); ++i) {
+				for (int column = rows[i]; column < nMonomials; ++column) {
+					size_t p = offsets[i - first] + column - rows[i];
+					moments.push_back(
+							recordWord(words[p], signs[p], Index(rows[i], column),
+									seen, seenWords, candidates));
+					moments_dagger.push_back(0);
+					if (rows[i] != column) {
+						moments_dagger.back() = recordWord(words_dagger[p],
+								signs_dagger[p], Index(column, rows[i]), seen,
+								seenWords, candidates);
+					}
+				}
+			}
+			blockDone(getBytes(words) + getBytes(words_dagger)
+					+ getBytes(seenWords)
+					+ (2 * signs.capacity() + moments.capacity()
+							+ moments_dagger.capacity()) * sizeof(int));
+		}
+    // A stopped rank sends no words, but it still takes part in the
+    // exchange so that the other ranks do not wait for it
+		exchangeDictionary(candidates);
+	}
+	vector<Word>().swap(words);
+	vector<Word>().swap(words_dagger);
+	seen.clear();
+	blockDone(getBytes(seenWords)
+			+ (moments.capacity() + moments_dagger.capacity()) * sizeof(int));
+  // Look up the positions of the words of this rank
+	vector<Index> positions(seenWords.size());
+	nRounds = agreeRounds(
+			(seenWords.size() + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS, nRanks,
+			communicator);
+	for (int round = 0; round < nRounds; ++round) {
+		size_t first = min((size_t) round * BLOCK_ELEMENTS, seenWords.size());
+		size_t last = min(first + BLOCK_ELEMENTS, seenWords.size());
+		resolveWords(seenWords, first, last, positions);
+	}
+	vector<Word>().swap(seenWords);
+	size_t p = 0;
+	Index index, index_dagger;
+	for (size_t i = 0; i < rows.size() && !control.isStopped(); ++i) {
+		for (int column = rows[i]; column < nMonomials; ++column, ++p) {
+			if (moments[p] != 0) {
+				index = positions[abs(moments[p]) - 1];
+			}
+			if (moments_dagger[p] != 0) {
+				index_dagger = positions[abs(moments_dagger[p]) - 1];
+			}
+			pushMomentEntries(blockIndex, rows[i], column, index,
+					(moments[p] > 0) - (moments[p] < 0), index_dagger,
+					(moments_dagger[p] > 0) - (moments_dagger[p] < 0));
+		}
+	}
+	blockDone(0);
+}
+
+/**
+ * Merge words first seen on this rank into the monomial dictionary of a
+ * distributed relaxation. The dictionary is divided among the ranks: each
+ * word is sent to its owner, and the owner keeps the earliest position in
+ * the serial order. This is a round of a collective exchange, which every
+ * rank has to call the same number of times.
+ */
+void SdpRelaxation::exchangeDictionary(
+		const vector<pair<Word, Index> > &localWords) {
+	vector<vector<unsigned int> > outgoing(nRanks);
+	for (vector<pair<Word, Index> >::const_iterator i = localWords.begin();
+			i != localWords.end(); ++i) {
+		vector<unsigned int> &buffer = outgoing[getOwner(i->first, nRanks)];
+		packWord(i->first, buffer);
+		buffer.push_back(i->second.first);
+		buffer.push_back(i->second.second);
+	}
+	vector<unsigned int> incoming;
+	vector<size_t> counts;
+	exchangeLists(outgoing, incoming, counts, communicator);
+  // The table is grown once for the words of the round
+	size_t nWords = 0;
+	for (size_t pos = 0; pos < incoming.size(); pos += incoming[pos] + 3) {
+		++nWords;
+	}
+	monomialDictionary.reserve(monomialDictionary.size() + nWords);
+	Word word;
+	for (size_t pos = 0; pos < incoming.size();) {
+		pos += unpackWord(&incoming[pos], word);
+		Index index(incoming[pos], incoming[pos + 1]);
+		pos += 2;
+		pair<Index, bool> result = monomialDictionary.insert(word, index);
+		if (!result.second && precedes(index, result.first)) {
+			*monomialDictionary.find(word) = index;
+		}
+	}
+}
+
+/**
+ * Look up the positions of words in the dictionary of a distributed
+ * relaxation. Each word is sent to its owner, which answers with the
+ * position where the moment was first seen, or with the top left corner if
+ * the word does not appear in the moment matrix. This is a round of a
+ * collective exchange, which every rank has to call the same number of
+ * times.
+ *
+ * Arguments:
+ * @param words - the words
+ * @param begin - the first word to look up in this round
+ * @param end - the word after the last one to look up in this round
+ * @param indices - the positions, in the same order as the words
+ */
+void SdpRelaxation::resolveWords(const vector<Word> &words,
+		const size_t begin, const size_t end, vector<Index> &indices) {
+	vector<vector<unsigned int> > queries(nRanks);
+	vector<vector<size_t> > asked(nRanks);
+	for (size_t i = begin; i < end; ++i) {
+		int owner = getOwner(words[i], nRanks);
+		packWord(words[i], queries[owner]);
+		asked[owner].push_back(i);
+	}
+	vector<unsigned int> incoming;
+	vector<size_t> counts;
+	exchangeLists(queries, incoming, counts, communicator);
+	vector<vector<Index> > answers(nRanks);
+	Word word;
+	size_t pos = 0;
+	for (int r = 0; r < nRanks; ++r) {
+		for (size_t last = pos + counts[r]; pos < last;) {
+			pos += unpackWord(&incoming[pos], word);
+			const Index *index = monomialDictionary.find(word);
+			answers[r].push_back(index == NULL ? Index(0, 0) : *index);
+		}
+	}
+	vector<Index> replies;
+	exchangeLists(answers, replies, counts, communicator);
+	size_t reply = 0;
+	for (int r = 0; r < nRanks; ++r) {
+		for (size_t i = 0; i < asked[r].size(); ++i) {
+			indices[asked[r][i]] = replies[reply++];
+		}
+	}
+}
+
+/*
+ * Given a monomial, apply the substitutions and find the word of the moment
+ * it maps to, together with its coefficient. The coefficient is zero if the
+ * substitutions reduce the monomial to zero.
+ */
+void SdpRelaxation::getMomentWord(const Symbolic monomial, Word &word,
+		double *coeff) {
+	*coeff = getCoefficient(monomial);
+	Symbolic newMonomial = applySubstitution(monomial / *coeff);
+	int sign;
+	getWord(newMonomial, word, &sign);
+	*coeff *= sign;
+}
+
+/*
+ * Given a monomial, find its mapping L_y(w) as the linear index k of the
+ * corresponding SDP variable, together with its coefficient. Monomials that
+ * do not appear in the moment matrix are mapped to the top left corner.
+ * Returns -1 if the substitutions reduce the monomial to zero.
+ */
+long long SdpRelaxation::getMomentIndex(const Symbolic monomial, double *coeff) {
+	Word &word = getScratch().word;
+	getMomentWord(monomial, word, coeff);
+	if (*coeff == 0) {
+		return -1;
+	}
+	const Index *index = monomialDictionary.find(word);
+	if (index == NULL) {
+		return index2linear(0, 0, nMonomials);
 	}
+	return index2linear(index->first, index->second, nMonomials);
+}
+
+/**
+ * Helper function to merge the moments of the (u,w) element of a localizing
+ * matrix that map to the same SDP variable into a single entry each.
+ */
+static void mergeMoments(vector<pair<long long, double> > &moments,
+		const int blockIndex, const int row, const int column,
+		vector<pair<long long, Entry> > &entries) {
+	sort(moments.begin(), moments.end());
 	Entry entry;
-  // Identify its constituent monomials    
-	for (list<Symbolic>::const_iterator monomial = factors.begin();
-			monomial != factors.end(); ++monomial) {
-		double coeff = getCoefficient(*monomial);
-		Symbolic newMonomial = applySubstitution(*monomial / coeff);
-		if (getCoefficient(newMonomial) < 0) {
-			newMonomial = -1 * newMonomial;
-			coeff = -1.0 * coeff;
-		}
-    // Given the monomial, we need its mapping L_y(w) to push it into
-    // a corresponding constraint matrix
-		Index index = monomialDictionary[newMonomial];
-		entry.blockIndex = blockIndex;
-		entry.row = i + 1;
-		entry.column = j + 1; 
-		entry.value = coeff;
-    // k identifies the mapped value of a word (monomial) w
-		int k = index2linear(index.first, index.second, nMonomials);
-		#pragma omp critical(pushFacVarSparse)
-		{
-		F[k].push_back(entry);
+	entry.blockIndex = blockIndex;
+	entry.row = row + 1;
+	entry.column = column + 1;
+	for (size_t i = 0; i < moments.size();) {
+		long long k = moments[i].first;
+		entry.value = 0;
+		for (; i < moments.size() && moments[i].first == k; ++i) {
+			entry.value += moments[i].second;
+		}
+		if (entry.value != 0) {
+			entries.push_back(make_pair(k, entry));
+		}
+	}
+}
+
+/* 
+ * Calculate the sparse vector representation of the (u,w) element of a
+ * localizing matrix and append it to a list of entries, each with the
+ * position in the F structure it belongs to. Terms that map to the same
+ * SDP variable are merged into a single entry.
+ */
+void SdpRelaxation::getFacVarSparse(const Terms &polynomial,
+		const vector<Symbolic> &monomials, const int blockIndex, const int row,
+		const int column, vector<pair<long long, Entry> > &entries) {
+	vector<pair<long long, double> > &moments = getScratch().moments;
+	moments.clear();
+	double coeff;
+	long long k;
+	for (Terms::const_iterator term = polynomial.begin();
+			term != polynomial.end(); ++term) {
+    // Calculate the moments of polynomial entries
+		Symbolic monomial = conjugate(monomials[row]) * term->second
+				* monomials[column];
+		k = getMomentIndex(monomial, &coeff);
+		if (row == column) {
+			if (k >= 0) {
+				moments.push_back(make_pair(k, term->first * coeff));
+			}
+		} else {
+      // Special care must be taken so that the resulting
+      // constraint matrices are symmetric, not just 
+      // Hermitian. The procedure is essentially the same as 
+      // above.            
+			if (k >= 0) {
+				moments.push_back(make_pair(k, 0.5 * term->first * coeff));
+			}
+			Symbolic monomial_dagger = conjugate(monomials[column]) * term->second
+					* monomials[row];
+			k = getMomentIndex(monomial_dagger, &coeff);
+			if (k >= 0) {
+				moments.push_back(make_pair(k, 0.5 * term->first * coeff));
+			}
 		}
 	}
+	mergeMoments(moments, blockIndex, row, column, entries);
 }
 
 /*
@@ -237,36 +914,68 @@ void SdpRelaxation::pushFacVarSparse(const Symbolic polynomial,
  * sparse entries to the constraint matrices, it returns a dense 
  * vector.
  */
-double *SdpRelaxation::getFacVar(const Symbolic polynomial) {
+double *SdpRelaxation::getFacVar(const Terms &polynomial) {
 	double *facVar = new double[nElements];
-	for (int i = 0; i < nElements; ++i) {
+	for (long long i = 0; i < nElements; ++i) {
 		facVar[i] = 0;
 	}
-	list<Symbolic> factors;
-  // Preprocess the polynomial for uniform handling later
-	if (polynomial.type() == typeid(Sum)) {
-		factors = CastPtr<const Sum>(polynomial)->summands;
-	} else {
-		factors.push_back(polynomial);
-	}
-  // Identify its constituent monomials    
-	for (list<Symbolic>::const_iterator monomial = factors.begin();
-			monomial != factors.end(); ++monomial) {
-		double coeff = getCoefficient(*monomial);
-		Symbolic newMonomial = applySubstitution(*monomial / coeff);
-		if (getCoefficient(newMonomial) < 0) {
-			newMonomial = -1 * newMonomial;
-			coeff = -1 * coeff;
-		}
-    // Given the monomial, we need its mapping L_y(w) to find its 
-    // location in the dense vector needed by the objective function.
-		Index index = monomialDictionary[newMonomial];
-		facVar[index2linear(index.first, index.second, nMonomials) - 1] +=
-				coeff;
+	double coeff;
+  // Find the location of each term in the dense vector needed by the
+  // objective function
+	for (size_t i = 0; i < polynomial.size(); ++i) {
+		long long k = getMomentIndex(polynomial[i].second, &coeff);
+		if (k > 0) {
+			facVar[k - 1] += polynomial[i].first * coeff;
+		}
 	}
 	return facVar;
 }
 
+/*
+ * Find the terms of the objective function of a distributed relaxation
+ * with their positions. The terms of the polynomial are divided among the
+ * ranks, and their words are looked up in the dictionary a block at a time.
+ * The terms are summed up when the variables are numbered.
+ */
+void SdpRelaxation::getDistributedObjective(const Terms &polynomial) {
+	objectiveTerms.clear();
+	vector<Word> words;
+	vector<PositionRecord> terms;
+	vector<Index> indices;
+	size_t nLocal = 0;
+	for (size_t i = rank; i < polynomial.size(); i += nRanks) {
+		++nLocal;
+	}
+	int nRounds = agreeRounds((nLocal + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS,
+			nRanks, communicator);
+	size_t i = rank;
+	for (int round = 0; round < nRounds; ++round) {
+		words.clear();
+		terms.clear();
+		for (; i < polynomial.size() && words.size() < BLOCK_ELEMENTS;
+				i += nRanks) {
+			double coeff;
+			words.push_back(Word());
+			getMomentWord(polynomial[i].second, words.back(), &coeff);
+			if (coeff == 0) {
+				words.pop_back();
+				continue;
+			}
+			PositionRecord term = { 0, (int) i, polynomial[i].first * coeff };
+			terms.push_back(term);
+		}
+		indices.resize(words.size());
+		resolveWords(words, 0, words.size(), indices);
+		for (size_t t = 0; t < terms.size(); ++t) {
+			terms[t].position = index2linear(indices[t].first, indices[t].second,
+					nMonomials);
+			objectiveTerms.push_back(terms[t]);
+		}
+	}
+	control.setUsage(MEMORY_OBJECTIVE,
+			objectiveTerms.capacity() * sizeof(PositionRecord));
+}
+
 /** 
  * Generate localizing matrices
  *
@@ -277,40 +986,271 @@ double *SdpRelaxation::getFacVar(const Symbolic polynomial) {
  *                      SDP relaxation
  * @param - the order of the relaxation        
  */
-void SdpRelaxation::processInequalities(const vector<Symbolic> inequalities,
-		const vector<Symbolic> monomials, const int blockIndex, const int order) {
+void SdpRelaxation::processInequalities(const vector<Terms> &inequalities,
+		const vector<Symbolic> &monomials, const int blockIndex,
+		const int order) {
   // Identify the correct set of monomials
 	int nIneqMonomials = countNcMonomials(monomials, order - 1);
   // Mark length of block in the constraint matrices
 	for (int k = 0; k<inequalities.size(); ++k) {
 		blockStruct.push_back(nIneqMonomials);
 	}
-  // Process M_y(gy)(u,w) entries. Technically this can be done in parallel.
-	#pragma omp parallel default(shared)
-	{
-    #pragma omp for schedule(runtime)
-    for (int k = 0; k<inequalities.size(); ++k) {
-      int localBlockIndex = blockIndex + k;
-      for (int row = 0; row < nIneqMonomials; ++row) {
-        for (int column = row; column < nIneqMonomials; ++column) {
-          // Calculate the moments of polynomial entries
-          Symbolic polynomial = conjugate(monomials[row]) * inequalities[k]
-              * monomials[column];
-          if (row == column) {
-              pushFacVarSparse(polynomial, localBlockIndex, row, column);
-          } else {
-              // Special care must be taken so that the resulting
-              // constraint matrices are symmetric, not just 
-              // Hermitian. The procedure is essentially the same as 
-              // above.            
-              Symbolic polynomial_dagger = conjugate(monomials[column]) * inequalities[k] * monomials[row];
-              Symbolic poly = 0.5*polynomial_dagger + 0.5*polynomial;
-              pushFacVarSparse(poly, localBlockIndex, row, column);          
-          }
-        }
-      }
-    }
-	} // End pragma
+  // The rows of all localizing matrices are numbered in the serial order.
+  // When the relaxation is distributed, they are dealt out to the MPI ranks
+  // as tiles.
+	vector<int> rows;
+	for (int i = rank; i < (int) inequalities.size() * nIneqMonomials;
+			i += nRanks) {
+		rows.push_back(i);
+	}
+	if (nRanks > 1) {
+		processDistributedInequalities(inequalities, monomials, blockIndex,
+				nIneqMonomials, rows);
+		return;
+	}
+  // Process M_y(gy)(u,w) entries a block of rows at a time: the entries of
+  // the rows are calculated in parallel, and pushed in the serial order.
+	vector<vector<pair<long long, Entry> > > rowEntries;
+	for (int first = 0; first < (int) rows.size() && !control.isStopped();) {
+		int last = first;
+		size_t nPairs = 0;
+		while (last < (int) rows.size() && nPairs < BLOCK_ELEMENTS) {
+			nPairs += nIneqMonomials - rows[last] % nIneqMonomials;
+			++last;
+		}
+		rowEntries.resize(last - first);
+		#pragma omp parallel for schedule(runtime)
+		for (int i = first; i < last; ++i) {
+			vector<pair<long long, Entry> > &entries = rowEntries[i - first];
+			entries.clear();
+			if (control.isStopped()) {
+				continue;
+			}
+			int k = rows[i] / nIneqMonomials;
+			int row = rows[i] % nIneqMonomials;
+			for (int column = row; column < nIneqMonomials; ++column) {
+				getFacVarSparse(inequalities[k], monomials, blockIndex + k, row,
+						column, entries);
+			}
+			rowDone(nIneqMonomials - row);
+		}
+		for (int i = first; i < last && !control.isStopped(); ++i) {
+			const vector<pair<long long, Entry> > &entries = rowEntries[i - first];
+			for (size_t e = 0; e < entries.size(); ++e) {
+				pushEntry(entries[e].first, entries[e].second);
+			}
+			control.addEntries(entries.size());
+		}
+		size_t bytes = rowEntries.capacity() * sizeof(vector<pair<long long, Entry> >);
+		for (size_t i = 0; i < rowEntries.size(); ++i) {
+			bytes += rowEntries[i].capacity() * sizeof(pair<long long, Entry>);
+		}
+		blockDone(bytes);
+		first = last;
+	}
+	blockDone(0);
+}
+
+/*
+ * Calculate the words of the moments of the (u,w) element of a localizing
+ * matrix of a distributed relaxation, with their coefficients. Their
+ * positions are looked up later, in the dictionary divided among the
+ * ranks.
+ */
+void SdpRelaxation::getMomentTerms(const Terms &polynomial,
+		const vector<Symbolic> &monomials, const int row, const int column,
+		vector<MomentTerm> &terms) {
+	double coeff;
+	for (Terms::const_iterator term = polynomial.begin();
+			term != polynomial.end(); ++term) {
+    // The element and its transpose are symmetrized as in getFacVarSparse
+		double factor = row == column ? term->first : 0.5 * term->first;
+		for (int transpose = 0; transpose < 1 + (row != column); ++transpose) {
+			Symbolic monomial = transpose == 0 ?
+					conjugate(monomials[row]) * term->second * monomials[column] :
+					conjugate(monomials[column]) * term->second * monomials[row];
+			terms.push_back(MomentTerm());
+			getMomentWord(monomial, terms.back().word, &coeff);
+			if (coeff == 0) {
+				terms.pop_back();
+				continue;
+			}
+			terms.back().column = column;
+			terms.back().value = factor * coeff;
+		}
+	}
+}
+
+/**
+ * Generate the localizing matrices of a distributed relaxation, a block of
+ * rows at a time. The words of the moments of the rows are calculated in
+ * parallel, the distinct words of the block are looked up in the
+ * dictionary at once, and the moments are then merged into entries in the
+ * serial order.
+ *
+ * Arguments:
+ * @param inequalities - inequality constraints
+ * @param monomials - monomials in the set |W_d| with d being the relaxation order
+ * @param blockIndex - the block index of the first localizing matrix
+ * @param nIneqMonomials - the size of a localizing matrix
+ * @param rows - the rows of all localizing matrices dealt to this rank
+ */
+void SdpRelaxation::processDistributedInequalities(
+		const vector<Terms> &inequalities, const vector<Symbolic> &monomials,
+		const int blockIndex, const int nIneqMonomials,
+		const vector<int> &rows) {
+  // The first local row of each block
+	vector<size_t> blocks(1, 0);
+	size_t nPairs = 0;
+	for (size_t i = 0; i < rows.size(); ++i) {
+		nPairs += nIneqMonomials - rows[i] % nIneqMonomials;
+		if (nPairs >= BLOCK_ELEMENTS || i + 1 == rows.size()) {
+			blocks.push_back(i + 1);
+			nPairs = 0;
+		}
+	}
+	vector<vector<MomentTerm> > rowTerms;
+	MonomialTable seen;
+	vector<Word> seenWords;
+	vector<Index> positions;
+	vector<pair<long long, double> > moments;
+	vector<pair<long long, Entry> > entries;
+	int nRounds = agreeRounds(blocks.size() - 1, nRanks, communicator);
+	for (int round = 0; round < nRounds; ++round) {
+		size_t first = 0, last = 0;
+		seen.clear();
+		seenWords.clear();
+		if (round < (int) blocks.size() - 1 && !control.isStopped()) {
+			first = blocks[round];
+			last = blocks[round + 1];
+			rowTerms.resize(last - first);
+			#pragma omp parallel for schedule(runtime)
+			for (int i = first; i < (int) last; ++i) {
+				vector<MomentTerm> &terms = rowTerms[i - first];
+				terms.clear();
+				if (control.isStopped()) {
+					continue;
+				}
+				int k = rows[i] / nIneqMonomials;
+				int row = rows[i] % nIneqMonomials;
+				for (int column = row; column < nIneqMonomials; ++column) {
+					getMomentTerms(inequalities[k], monomials, row, column, terms);
+				}
+				rowDone(nIneqMonomials - row);
+			}
+			for (size_t i = 0; i < last - first; ++i) {
+				vector<MomentTerm> &terms = rowTerms[i];
+				for (size_t t = 0; t < terms.size(); ++t) {
+					pair<Index, bool> result = seen.insert(terms[t].word,
+							Index(seenWords.size(), 0));
+					if (result.second) {
+						seenWords.push_back(terms[t].word);
+					}
+					terms[t].id = result.first.first;
+				}
+			}
+		}
+    // A stopped rank looks up no words, but it still takes part in the
+    // exchange so that the other ranks do not wait for it
+		positions.resize(seenWords.size());
+		resolveWords(seenWords, 0, seenWords.size(), positions);
+		for (size_t i = first; i < last && !control.isStopped(); ++i) {
+			const vector<MomentTerm> &terms = rowTerms[i - first];
+			int k = rows[i] / nIneqMonomials;
+			int row = rows[i] % nIneqMonomials;
+			entries.clear();
+			for (size_t t = 0; t < terms.size();) {
+				int column = terms[t].column;
+				moments.clear();
+				for (; t < terms.size() && terms[t].column == column; ++t) {
+					Index index = positions[terms[t].id];
+					moments.push_back(
+							make_pair(index2linear(index.first, index.second, nMonomials),
+									terms[t].value));
+				}
+				mergeMoments(moments, blockIndex + k, row, column, entries);
+			}
+			for (size_t e = 0; e < entries.size(); ++e) {
+				pushEntry(entries[e].first, entries[e].second);
+			}
+			control.addEntries(entries.size());
+		}
+		if (first < last) {
+			size_t bytes = getBytes(seenWords) + seen.bytes()
+					+ positions.capacity() * sizeof(Index)
+					+ rowTerms.capacity() * sizeof(vector<MomentTerm>)
+					+ entries.capacity() * sizeof(pair<long long, Entry>);
+			for (size_t i = 0; i < rowTerms.size(); ++i) {
+				bytes += rowTerms[i].capacity() * sizeof(MomentTerm);
+				for (size_t t = 0; t < rowTerms[i].size(); ++t) {
+					bytes += rowTerms[i][t].word.letters.capacity()
+							* sizeof(unsigned int);
+				}
+			}
+			blockDone(bytes);
+		}
+	}
+	blockDone(0);
+}
+
+/**
+ * Helper function to split a polynomial into terms of a coefficient and a
+ * monomial with unit coefficient.
+ */
+static Terms getTerms(const Symbolic polynomial) {
+	Terms terms;
+	if (polynomial.type() == typeid(Sum)) {
+		CastPtr<const Sum> sum = polynomial;
+		for (list<Symbolic>::const_iterator monomial = sum->summands.begin();
+				monomial != sum->summands.end(); ++monomial) {
+			double coeff = getCoefficient(*monomial);
+			terms.push_back(make_pair(coeff, *monomial / coeff));
+		}
+	} else {
+		double coeff = getCoefficient(polynomial);
+		if (coeff != 0) {
+			terms.push_back(make_pair(coeff, polynomial / coeff));
+		}
+	}
+	return terms;
+}
+
+/**
+ * Helper function to turn the words of a sparse polynomial into monomials
+ * of the noncommutative variables. The cost is linear in the number of
+ * terms. Clears valid if a word has a letter that is not a variable.
+ */
+static Terms getTerms(const SparsePolynomial &polynomial,
+		const Symbolic variables, bool *valid) {
+	Terms terms;
+	unsigned int nVars = variables.rows();
+	for (vector<Term>::const_iterator term = polynomial.terms.begin();
+			term != polynomial.terms.end(); ++term) {
+		if (term->coefficient == 0) {
+			continue;
+		}
+		Symbolic monomial = 1;
+		vector<unsigned int>::const_iterator letter;
+		for (letter = term->word.begin(); letter != term->word.end(); ++letter) {
+			if (*letter >= nVars) {
+				cerr << "Not a variable: " << *letter << endl;
+				*valid = false;
+				break;
+			}
+			monomial *= variables(*letter);
+		}
+		if (letter == term->word.end()) {
+			terms.push_back(make_pair(term->coefficient, monomial));
+		}
+	}
+	return terms;
+}
+
+static Terms negateTerms(Terms terms) {
+	for (Terms::iterator term = terms.begin(); term != terms.end(); ++term) {
+		term->first = -term->first;
+	}
+	return terms;
 }
 
 /** Obtain SDP relaxation
@@ -323,52 +1263,552 @@ void SdpRelaxation::processInequalities(const vector<Symbolic> inequalities,
 void SdpRelaxation::getRelaxation(const Symbolic variables,
 		const Symbolic objective, vector<Symbolic> inequalities,
 		const vector<Symbolic> equalities, const short int order) {
+	vector<Terms> ineqTerms, eqTerms;
+	for (vector<Symbolic>::const_iterator ineq = inequalities.begin();
+			ineq != inequalities.end(); ++ineq) {
+		ineqTerms.push_back(getTerms(*ineq));
+	}
+	for (vector<Symbolic>::const_iterator eq = equalities.begin();
+			eq != equalities.end(); ++eq) {
+		eqTerms.push_back(getTerms(*eq));
+	}
+	generateRelaxation(variables, getTerms(objective), ineqTerms, eqTerms,
+			order);
+}
+
+/** Obtain SDP relaxation of a problem given as lists of terms. This avoids
+ * building the polynomials symbolically, which is quadratic in the number
+ * of terms. The build ends with BUILD_INVALID if a term has a letter that
+ * is not a variable.
+ *
+ * @param variables - the noncommutative variables
+ * @param objective - the objective function to minimize
+ * @param inequalities - the list of inequality constraints
+ * @param equalities - the list of equality constraints
+ * @param order - the order of the relaxation
+ */
+void SdpRelaxation::getRelaxation(const Symbolic variables,
+		const SparsePolynomial &objective,
+		const vector<SparsePolynomial> &inequalities,
+		const vector<SparsePolynomial> &equalities, const short int order) {
+	vector<Terms> ineqTerms, eqTerms;
+	bool valid = true;
+	for (vector<SparsePolynomial>::const_iterator ineq = inequalities.begin();
+			ineq != inequalities.end(); ++ineq) {
+		ineqTerms.push_back(getTerms(*ineq, variables, &valid));
+	}
+	for (vector<SparsePolynomial>::const_iterator eq = equalities.begin();
+			eq != equalities.end(); ++eq) {
+		eqTerms.push_back(getTerms(*eq, variables, &valid));
+	}
+	Terms objTerms = getTerms(objective, variables, &valid);
+	if (!valid) {
+		releaseRelaxation();
+		control.begin(0, 0);
+		control.finish(BUILD_INVALID);
+		return;
+	}
+	generateRelaxation(variables, objTerms, ineqTerms, eqTerms, order);
+}
+
+/** Obtain SDP relaxation of a problem read from a file
+ * @param variables - the noncommutative variables
+ * @param problem - the objective function and the constraints
+ * @param order - the order of the relaxation
+ */
+void SdpRelaxation::getRelaxation(const Symbolic variables,
+		const SparseProblem &problem, const short int order) {
+	getRelaxation(variables, problem.objective, problem.inequalities,
+			problem.equalities, order);
+}
+
+/** Use a monomial basis shared with other relaxations instead of
+ * enumerating it for every build
+ * @param basis - the basis returned by getNcMonomials for the variables
+ *                and the order of the builds to come, which must outlive
+ *                them; NULL to enumerate the basis again
+ */
+void SdpRelaxation::setBasis(const vector<Symbolic> *basis) {
+	this->basis = basis;
+}
+
+/** Turn the messages on the standard output on or off
+ * @param verbose - whether to report the stages of a build
+ */
+void SdpRelaxation::setVerbose(const bool verbose) {
+	this->verbose = verbose;
+}
+
+/** Set the time and memory limits of subsequent builds
+ * @param budget - the limits, zero for none
+ */
+void SdpRelaxation::setBudget(const BuildBudget &budget) {
+	control.setBudget(budget);
+}
+
+/** Set a function to be called as a build progresses. It is called from
+ * the threads of the build, about a hundred times per build and once at
+ * the end.
+ * @param callback - the function, NULL for none
+ * @param data - passed on to the function
+ */
+void SdpRelaxation::setProgressCallback(ProgressCallback callback,
+		void *data) {
+	control.setCallback(callback, data);
+}
+
+/**
+ * Returns the progress of the current or last build. Safe to call from
+ * any thread.
+ */
+BuildProgress SdpRelaxation::getProgress() const {
+	return control.getProgress();
+}
+
+BuildStatus SdpRelaxation::getStatus() const {
+	return control.getStatus();
+}
+
+/**
+ * Returns the bytes held by each structure of the relaxation in this
+ * process. Safe to call from any thread, also during a build. A stopped
+ * build releases its structures, so afterwards this returns the bytes held
+ * when it stopped; getProgress tells which structure broke the budget.
+ */
+MemoryUsage SdpRelaxation::getMemoryUsage() const {
+	return control.getMemoryUsage();
+}
+
+/**
+ * Ask a running build to stop. The threads of the build finish the row at
+ * hand and skip the rest. Safe to call from any thread.
+ */
+void SdpRelaxation::cancel() {
+	control.stop(BUILD_CANCELLED);
+}
+
+void SdpRelaxation::generateRelaxation(const Symbolic variables,
+		const Terms &objective, vector<Terms> inequalities,
+		const vector<Terms> &equalities, const short int order) {
 
   // Generate the set W_d containing words (monomials) of length up to d,
-  // where d is the relaxation order
-	vector<Symbolic> monomials = getNcMonomials(variables, order);
+  // where d is the relaxation order, unless a shared one was given
+	vector<Symbolic> ownBasis;
+	if (basis == NULL) {
+		ownBasis = getNcMonomials(variables, order);
+	}
+	const vector<Symbolic> &monomials = basis != NULL ? *basis : ownBasis;
   
   // Initialize some helper variables, including the offsets of monomial
   // blocks if there is more than one.
 	nMonomials = monomials.size();
-	nElements = nMonomials * nMonomials; 
+	nElements = (long long) nMonomials * nMonomials;
   int blockIndex;
-  // Initialize sparse constant matrices in the target SDP
-	F = new list<Entry> [nElements + 1];
+  releaseRelaxation();
+
+  // Count the rows of the moment and localizing matrices generated by this
+  // rank for the progress report
+  long long rowsTotal = 0, elementsTotal = 0;
+  for (int row = rank; row < nMonomials; row += nRanks) {
+    ++rowsTotal;
+    elementsTotal += nMonomials - row;
+  }
+  int nIneqMonomials = countNcMonomials(monomials, order - 1);
+  int nIneqRows = (inequalities.size() + 2 * equalities.size())
+      * nIneqMonomials;
+  for (int i = rank; i < nIneqRows; i += nRanks) {
+    ++rowsTotal;
+    elementsTotal += nIneqMonomials - i % nIneqMonomials;
+  }
+  control.begin(rowsTotal, elementsTotal);
+
+  // Check the structures whose size is known up front against the memory
+  // budget before allocating them
+  size_t dictionaryReserve;
+  if (!planMemory(monomials, &dictionaryReserve)) {
+    finishBuild();
+    return;
+  }
+  // Initialize sparse constant matrices in the target SDP. A distributed
+  // relaxation keeps only the entries of its own rows in a list instead.
+  if (nRanks == 1) {
+    F.assign(nElements + 1, EntryList(ArenaAllocator<Entry>(&arenas)));
+  }
+  // One set of buffers for each thread of the parallel loops
+  int nThreads = 1;
+#ifdef _OPENMP
+  nThreads = omp_get_max_threads();
+#endif
+  scratch.resize(nThreads);
+  // Map the variables to their indices in the words of the monomial
+  // dictionary, and make room for the moments expected
+  letters.clear();
+  for (int i = 0; i < variables.rows(); ++i) {
+    letters[variables(i)] = i;
+  }
+  monomialDictionary.reserve(dictionaryReserve);
+  control.setUsage(MEMORY_DICTIONARY, monomialDictionary.bytes());
 
   // Generate moment matrices for each blocks of variables 
-	cout << "Generating moments..." << endl;
+  if (verbose && rank == 0) {
+    cout << "Generating moments..." << endl;
+  }
+  control.setStage("moments");
   generateMomentMatrix(monomials, &blockIndex);
 	
   
-  // Objective function needs dense representation
-	objFacVar = getFacVar(objective);
+  // Objective function needs dense representation, unless the relaxation
+  // is distributed
+  control.setStage("objective");
+  if (nRanks > 1) {
+    getDistributedObjective(objective);
+  } else {
+    objFacVar = getFacVar(objective);
+  }
 
   // Equalities are converted to pairs of inequalities
-	cout << "Transforming " << equalities.size() << " equalities to "
-			<< 2 * equalities.size() << " inequalities..." << endl;
-	for (vector<Symbolic>::const_iterator eq = equalities.begin();
+  if (verbose && rank == 0) {
+    cout << "Transforming " << equalities.size() << " equalities to "
+        << 2 * equalities.size() << " inequalities..." << endl;
+  }
+	for (vector<Terms>::const_iterator eq = equalities.begin();
 			eq != equalities.end(); ++eq) {
 		inequalities.push_back(*eq);
-		inequalities.push_back(-*eq);
+		inequalities.push_back(negateTerms(*eq));
 	}
   
   // Process inequalities
-	cout << "Processing " << inequalities.size() << " inequalitites..." << endl;
+  if (verbose && rank == 0) {
+    cout << "Processing " << inequalities.size() << " inequalitites..."
+        << endl;
+  }
+  control.setStage("inequalities");
 	processInequalities(inequalities, monomials, blockIndex, order);
 
+  finishBuild();
 }
 
-/** Write an SDP relaxation to SDPA format
- * @param filename - the name of the file
+/**
+ * Settle the outcome of a build. A stopped build releases its partial
+ * constraint matrices; if the relaxation is distributed, the ranks agree
+ * to stop if any of them did.
+ */
+void SdpRelaxation::finishBuild() {
+	int status = control.isStopped() ? control.getStatus() : BUILD_DONE;
+#ifdef HAVE_MPI
+	if (nRanks > 1) {
+		MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX,
+				getComm(communicator));
+	}
+#endif
+	if (status != BUILD_DONE) {
+    // A rank stopped by another one keeps its own usage at the stop too
+		control.stop((BuildStatus) status);
+		if (rank == 0) {
+			cerr << "Relaxation stopped: " << getStatusName((BuildStatus) status)
+					<< endl;
+		}
+		if (control.getStatus() == BUILD_OUT_OF_MEMORY) {
+			if (nRanks > 1) {
+				cerr << "Memory of rank " << rank << ":\n";
+			}
+			control.writeMemoryReport(cerr);
+		}
+		releaseRelaxation();
+	} else {
+		if (nRanks > 1) {
+			numberDistributedVariables();
+		} else {
+			numberVariables();
+		}
+		if (verbose && rank == 0) {
+			cout << nVariables << " SDP variables" << endl;
+		}
+	}
+	control.finish((BuildStatus) status);
+}
+
+/**
+ * Number the SDP variables consecutively. Only the positions where a
+ * moment was first seen carry a variable, the rest of the nElements
+ * positions are skipped.
+ */
+void SdpRelaxation::numberVariables() {
+	// Mark the positions in use first, then number them in place
+	variableIndex.assign(nElements + 1, 0);
+	for (long long k = 1; k < nElements + 1; ++k) {
+		variableIndex[k] = !F[k].empty() || objFacVar[k - 1] != 0;
+	}
+	nVariables = 0;
+	for (long long k = 1; k < nElements + 1; ++k) {
+		if (variableIndex[k]) {
+			variableIndex[k] = ++nVariables;
+		}
+	}
+}
+
+/**
+ * Helper function to order the entries of a distributed relaxation by
+ * their positions.
+ */
+static bool precedesEntry(const pair<long long, Entry> &a,
+		const pair<long long, Entry> &b) {
+	return a.first < b.first;
+}
+
+/**
+ * Helper function to order the records sent for numbering by their
+ * positions, and the terms of the objective function of a position in the
+ * order of the polynomial, as they are summed up in a serial run.
+ */
+static bool precedesRecord(const PositionRecord &a,
+		const PositionRecord &b) {
+	return a.position < b.position
+			|| (a.position == b.position && a.term < b.term);
+}
+
+/**
+ * Number the SDP variables of a distributed relaxation consecutively, in
+ * the order of the positions as numberVariables does. Each rank numbers a
+ * contiguous range of the positions. The other ranks send it the positions
+ * in its range that hold their entries, and the terms of the objective
+ * function that map there. It answers with the numbers of the positions.
+ * The nonzero coefficients of the objective function are gathered on the
+ * first rank, which writes them.
+ */
+void SdpRelaxation::numberDistributedVariables() {
+	stable_sort(localEntries.begin(), localEntries.end(), precedesEntry);
+	localPositions.clear();
+	for (vector<pair<long long, Entry> >::const_iterator e = localEntries.begin();
+			e != localEntries.end(); ++e) {
+		if (localPositions.empty() || localPositions.back() != e->first) {
+			localPositions.push_back(e->first);
+		}
+	}
+	localVariables.assign(localPositions.size(), 0);
+  // Position zero is the constant term, which is not a variable
+	long long range = nElements / nRanks + 1;
+	vector<vector<PositionRecord> > outgoing(nRanks);
+	vector<vector<size_t> > sent(nRanks);
+	for (size_t i = 0; i < localPositions.size(); ++i) {
+		if (localPositions[i] > 0) {
+			PositionRecord record = { localPositions[i], -1, 0 };
+			outgoing[localPositions[i] / range].push_back(record);
+			sent[localPositions[i] / range].push_back(i);
+		}
+	}
+	for (vector<PositionRecord>::const_iterator t = objectiveTerms.begin();
+			t != objectiveTerms.end(); ++t) {
+		outgoing[t->position / range].push_back(*t);
+	}
+	vector<PositionRecord>().swap(objectiveTerms);
+	vector<PositionRecord> incoming;
+	vector<size_t> counts;
+	exchangeLists(outgoing, incoming, counts, communicator);
+	vector<vector<PositionRecord> >().swap(outgoing);
+  // Sum up the records of each position of this range
+	vector<size_t> order(incoming.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+	sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return precedesRecord(incoming[a], incoming[b]);
+	});
+	vector<long long> numbers(incoming.size());
+	vector<pair<long long, double> > coefficients;
+	long long nOwned = 0;
+	for (size_t i = 0; i < order.size();) {
+		long long position = incoming[order[i]].position;
+		bool used = false;
+		double coefficient = 0;
+		size_t j = i;
+		for (; j < order.size() && incoming[order[j]].position == position; ++j) {
+			if (incoming[order[j]].term < 0) {
+				used = true;
+			} else {
+				coefficient += incoming[order[j]].coefficient;
+			}
+		}
+		if (used || coefficient != 0) {
+			++nOwned;
+			coefficients.push_back(make_pair(nOwned, coefficient));
+		}
+		for (; i < j; ++i) {
+			numbers[order[i]] = used || coefficient != 0 ? nOwned : 0;
+		}
+	}
+  // Shift the numbers of this range by the variables of the ranges before
+	long long offset = 0;
+	nVariables = nOwned;
+#ifdef HAVE_MPI
+	MPI_Exscan(&nOwned, &offset, 1, MPI_LONG_LONG, MPI_SUM,
+			getComm(communicator));
+	if (rank == 0) {
+		offset = 0;
+	}
+	MPI_Allreduce(&nOwned, &nVariables, 1, MPI_LONG_LONG, MPI_SUM,
+			getComm(communicator));
+#endif
+	vector<vector<long long> > answers(nRanks);
+	size_t pos = 0;
+	for (int r = 0; r < nRanks; ++r) {
+		for (size_t last = pos + counts[r]; pos < last; ++pos) {
+			if (incoming[pos].term < 0) {
+				answers[r].push_back(numbers[pos] + offset);
+			}
+		}
+	}
+	vector<PositionRecord>().swap(incoming);
+	vector<long long> replies;
+	exchangeLists(answers, replies, counts, communicator);
+	size_t reply = 0;
+	for (int r = 0; r < nRanks; ++r) {
+		for (size_t i = 0; i < sent[r].size(); ++i) {
+			localVariables[sent[r][i]] = replies[reply++];
+		}
+	}
+  // The ranges follow each other in the order of the ranks, so the gathered
+  // coefficients are in the order of the variables
+	objectiveCoefficients.clear();
+	for (size_t i = 0; i < coefficients.size(); ++i) {
+		if (coefficients[i].second != 0) {
+			objectiveCoefficients.push_back(
+					make_pair(coefficients[i].first + offset,
+							coefficients[i].second));
+		}
+	}
+  // The first rank gathers the coefficients
+	vector<vector<pair<long long, double> > > toFirst(nRanks);
+	toFirst[0].swap(objectiveCoefficients);
+	exchangeLists(toFirst, objectiveCoefficients, counts, communicator);
+	control.setUsage(MEMORY_OBJECTIVE,
+			objectiveCoefficients.capacity() * sizeof(pair<long long, double>));
+	control.setUsage(MEMORY_VARIABLES,
+			(localPositions.capacity() + localVariables.capacity())
+					* sizeof(long long));
+}
+
+/**
+ * Helper function to account for a finished row of the moment or a
+ * localizing matrix. Returns false if the build should stop.
+ */
+bool SdpRelaxation::rowDone(const long long elements) {
+	setConstraintUsage();
+	return control.rowDone(elements);
+}
+
+/**
+ * Helper function to account for the entries pushed from a block of rows,
+ * and for the buffers of the block, and check them against the memory
+ * budget. The entries are pushed after the rows of the block are done, so
+ * this is where the constraint matrices grow. Returns false if the build
+ * should stop.
+ *
+ * Arguments:
+ * @param bufferBytes - the bytes held by the buffers of the block
+ */
+bool SdpRelaxation::blockDone(const size_t bufferBytes) {
+  // The usage that stopped a build is kept for the memory report
+	if (control.isStopped()) {
+		return false;
+	}
+	blockBytes = bufferBytes;
+	setConstraintUsage();
+	control.setUsage(MEMORY_DICTIONARY, monomialDictionary.bytes());
+	return control.checkMemory();
+}
+
+/**
+ * Helper function to account for the constraint matrices built so far,
+ * together with the buffers of the block of rows at hand.
+ */
+void SdpRelaxation::setConstraintUsage() {
+	control.setUsage(MEMORY_CONSTRAINTS,
+			F.capacity() * sizeof(EntryList) + arenas.bytes()
+					+ localEntries.capacity() * sizeof(pair<long long, Entry>)
+					+ blockBytes);
+}
+
+/**
+ * Account for the structures whose size is known before the build starts,
+ * and check them against the memory budget. The dictionary is reserved
+ * for an estimate of the distinct moments: the upper triangle of the
+ * moment matrix, shrunk by the order of the symmetry group if any. It grows
+ * past the estimate on demand. If even the estimate would break the
+ * budget, nothing is reserved up front, at the cost of rehashing.
+ *
+ * Arguments:
+ * @param monomials - the monomial basis
+ * @param dictionaryReserve - the number of words to reserve the
+ *                            dictionary for
+ *
+ * Returns false if the relaxation does not fit the budget.
  */
-void SdpRelaxation::writeToSdpa(const char *filename) {
-	ofstream outfile(filename);
+bool SdpRelaxation::planMemory(const vector<Symbolic> &monomials,
+		size_t *dictionaryReserve) {
+	size_t basisBytes = monomials.capacity() * sizeof(Symbolic);
+	for (vector<Symbolic>::const_iterator i = monomials.begin();
+			i != monomials.end(); ++i) {
+		basisBytes += ncDegree(*i) * SYMBOLIC_FACTOR_BYTES;
+	}
+	control.setUsage(MEMORY_BASIS, basisBytes);
+	*dictionaryReserve = (size_t) nMonomials * (nMonomials + 1) / 2;
+	if (symmetry != NULL) {
+		*dictionaryReserve /= symmetry->order();
+	}
+  // A distributed relaxation allocates nothing per position of the moment
+  // matrix, and each rank owns a share of the dictionary
+	if (nRanks > 1) {
+		*dictionaryReserve /= nRanks;
+	} else {
+		control.setUsage(MEMORY_CONSTRAINTS,
+				(nElements + 1) * sizeof(EntryList));
+		control.setUsage(MEMORY_OBJECTIVE, nElements * sizeof(double));
+		control.setUsage(MEMORY_VARIABLES,
+				(nElements + 1) * sizeof(long long));
+	}
+	control.setUsage(MEMORY_DICTIONARY,
+			MonomialTable::getReservedBytes(*dictionaryReserve));
+	if (control.findExceeded() >= 0) {
+		*dictionaryReserve = 0;
+		control.setUsage(MEMORY_DICTIONARY, 0);
+		if (verbose && rank == 0) {
+			cout << "The monomial dictionary grows on demand to save memory"
+					<< endl;
+		}
+	}
+	return control.checkMemory();
+}
+
+/**
+ * Release every structure of the current relaxation and account for it.
+ */
+void SdpRelaxation::releaseRelaxation() {
+	vector<EntryList>().swap(F);
+	arenas.release();
+	blockStruct.clear();
+	monomialDictionary.clear();
+	delete[] objFacVar;
+	objFacVar = NULL;
+	vector<long long>().swap(variableIndex);
+	vector<pair<long long, Entry> >().swap(localEntries);
+	vector<long long>().swap(localPositions);
+	vector<long long>().swap(localVariables);
+	vector<PositionRecord>().swap(objectiveTerms);
+	vector<pair<long long, double> >().swap(objectiveCoefficients);
+	blockBytes = 0;
+	nVariables = 0;
+	for (int i = 0; i < N_MEMORY_STRUCTURES; ++i) {
+		control.setUsage((MemoryStructure) i, 0);
+	}
+}
 
-	// Writing header
+/**
+ * Write the header and the objective function in SDPA format.
+ */
+void SdpRelaxation::writeHeader(ostream &outfile, const char *filename) {
 	outfile << "\"file " << filename << " generated by ncpol2sdpa\"\n";
-	cout << "writing problem in " << filename << endl;
-	outfile << nElements << " = number of vars\n";
+	outfile << nVariables << " = number of vars\n";
 	outfile << blockStruct.size() << " = number of blocs\n";
 	outfile << "(";
 	for (unsigned int i = 0; i < blockStruct.size(); ++i) {
@@ -379,24 +1819,490 @@ void SdpRelaxation::writeToSdpa(const char *filename) {
 			outfile << ") = BlocStructure\n";
 		}
 	}
-	// Objective function
+	// Objective function. A distributed relaxation has only the nonzero
+	// coefficients, in the order of the variables.
 	outfile << "{";
-	for (int i = 0; i < nElements; ++i) {
-		outfile << objFacVar[i];
-		if (i != nElements - 1) {
+	if (nRanks > 1) {
+		size_t t = 0;
+		for (long long v = 1; v <= nVariables; ++v) {
+			double value = 0;
+			if (t < objectiveCoefficients.size()
+					&& objectiveCoefficients[t].first == v) {
+				value = objectiveCoefficients[t++].second;
+			}
+			outfile << value;
+			if (v != nVariables) {
+				outfile << ", ";
+			}
+		}
+		outfile << "}\n";
+		return;
+	}
+	for (long long k = 1; k < nElements + 1; ++k) {
+		if (variableIndex[k] == 0) {
+			continue;
+		}
+		outfile << objFacVar[k - 1];
+		if (variableIndex[k] != nVariables) {
 			outfile << ", ";
-		} else {
-			outfile << "}\n";
 		}
+	}
+	outfile << "}\n";
+}
 
+/**
+ * Write the entries of the constraint matrices held by this rank in SDPA
+ * format, for the positions from begin up to but not including end.
+ */
+void SdpRelaxation::writeEntries(ostream &outfile, const long long begin,
+		const long long end) {
+	if (nRanks > 1) {
+    // The entries and the positions of a distributed relaxation are sorted
+		pair<long long, Entry> first(begin, Entry());
+		vector<pair<long long, Entry> >::const_iterator e = lower_bound(
+				localEntries.begin(), localEntries.end(), first, precedesEntry);
+		size_t v = lower_bound(localPositions.begin(), localPositions.end(),
+				begin) - localPositions.begin();
+		for (; e != localEntries.end() && e->first < end; ++e) {
+			while (localPositions[v] < e->first) {
+				++v;
+			}
+			outfile << localVariables[v] << "\t" << e->second.blockIndex << "\t"
+					<< e->second.row << "\t" << e->second.column << "\t"
+					<< e->second.value << "\n";
+		}
+		return;
 	}
-	// Writing entries
-	for (int k = 0; k < nElements + 1; ++k) {
-		for (list<Entry>::const_iterator e = F[k].begin(); e != F[k].end();
+	for (long long k = begin; k < end; ++k) {
+		for (EntryList::const_iterator e = F[k].begin(); e != F[k].end();
 				++e) {
-			outfile << k << "\t" << e->blockIndex << "\t" << e->row << "\t"
-					<< e->column << "\t" << e->value << "\n";
+			outfile << variableIndex[k] << "\t" << e->blockIndex << "\t"
+					<< e->row << "\t" << e->column << "\t" << e->value << "\n";
+		}
+	}
+}
+
+/**
+ * Output buffer that passes what is written to it on in pieces of at most
+ * SDPA_HEADER_PIECE_BYTES, each compressed to a gzip member if asked to, so
+ * that a large header such as the objective function of many variables is
+ * never held whole.
+ */
+class PieceBuffer: public streambuf {
+public:
+	PieceBuffer(const bool compress) :
+			compress(compress), compressed(true), buffer(SDPA_HEADER_PIECE_BYTES) {
+		setp(&buffer[0], &buffer[0] + buffer.size());
+	}
+	virtual ~PieceBuffer() {
+	}
+	bool isCompressed() const {
+		return compressed;
+	}
+
+protected:
+	virtual bool writePiece(const char *data, const size_t size) = 0;
+
+	int overflow(int c) {
+		if (!flushPiece()) {
+			return traits_type::eof();
+		}
+		if (!traits_type::eq_int_type(c, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(c);
+			pbump(1);
+		}
+		return traits_type::not_eof(c);
+	}
+
+	int sync() {
+		return flushPiece() ? 0 : -1;
+	}
+
+private:
+	bool compress;
+	bool compressed;
+	vector<char> buffer;
+
+	bool flushPiece() {
+		size_t size = pptr() - pbase();
+		setp(&buffer[0], &buffer[0] + buffer.size());
+		if (size == 0) {
+			return true;
+		}
+		if (!compress) {
+			return writePiece(&buffer[0], size);
+		}
+		string member;
+		if (!gzipCompress(string(&buffer[0], size), member)) {
+			compressed = false;
+			return false;
+		}
+		return writePiece(member.data(), member.size());
+	}
+};
+
+/**
+ * Output buffer that writes the pieces to a stream.
+ */
+class StreamPieces: public PieceBuffer {
+public:
+	StreamPieces(ostream &outfile, const bool compress) :
+			PieceBuffer(compress), outfile(outfile) {
+	}
+
+protected:
+	bool writePiece(const char *data, const size_t size) {
+		outfile.write(data, size);
+		return outfile.good();
+	}
+
+private:
+	ostream &outfile;
+};
+
+#ifdef HAVE_MPI
+/**
+ * Helper function to write to an MPI file at an offset. MPI counts are
+ * ints, so large pieces are written in parts.
+ */
+static bool writeAt(MPI_File file, const MPI_Offset offset, const char *data,
+		const size_t size) {
+	for (size_t done = 0; done < size;) {
+		int count = min(size - done, (size_t) INT_MAX);
+		if (MPI_File_write_at(file, offset + done,
+				const_cast<char *>(data) + done, count, MPI_CHAR,
+				MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+			return false;
+		}
+		done += count;
+	}
+	return true;
+}
+
+/**
+ * Output buffer that writes the pieces to an MPI file one after the other
+ * from an offset on.
+ */
+class MpiFilePieces: public PieceBuffer {
+public:
+	MpiFilePieces(MPI_File file, const MPI_Offset offset, const bool compress) :
+			PieceBuffer(compress), file(file), offset(offset), written(true) {
+	}
+	MPI_Offset getOffset() const {
+		return offset;
+	}
+	bool isWritten() const {
+		return written;
+	}
+
+protected:
+	bool writePiece(const char *data, const size_t size) {
+		written = writeAt(file, offset, data, size);
+		offset += size;
+		return written;
+	}
+
+private:
+	MPI_File file;
+	MPI_Offset offset;
+	bool written;
+};
+#endif
+
+/**
+ * Cut the entries held by this rank into chunks of consecutive positions of
+ * about SDPA_CHUNK_ENTRIES entries each. A chunk goes from one bound up to
+ * but not including the next.
+ */
+void SdpRelaxation::getChunkBounds(vector<long long> &bounds) {
+	bounds.assign(1, 0);
+	size_t count = 0;
+	if (nRanks > 1) {
+		for (size_t i = 0; i < localEntries.size(); ++i) {
+			++count;
+			if (count >= SDPA_CHUNK_ENTRIES && (i + 1 == localEntries.size()
+					|| localEntries[i + 1].first != localEntries[i].first)) {
+				bounds.push_back(localEntries[i].first + 1);
+				count = 0;
+			}
+		}
+	} else {
+		for (long long k = 0; k < nElements + 1; ++k) {
+			count += F[k].size();
+			if (count >= SDPA_CHUNK_ENTRIES) {
+				bounds.push_back(k + 1);
+				count = 0;
+			}
 		}
 	}
+	if (bounds.back() != nElements + 1) {
+		bounds.push_back(nElements + 1);
+	}
+}
+
+/**
+ * Format the chunks from first up to but not including last in parallel,
+ * each compressed to an independent gzip member if asked to.
+ *
+ * Returns false if compression failed.
+ *
+ * @param bounds - the bounds of the chunks from getChunkBounds
+ * @param pieces - the formatted chunks, from the first on
+ */
+bool SdpRelaxation::formatChunks(const vector<long long> &bounds,
+		const int first, const int last, const SdpaCompression compression,
+		vector<string> &pieces) {
+	int failed = 0;
+	#pragma omp parallel for schedule(dynamic) reduction(+:failed)
+	for (int c = first; c < last; ++c) {
+		ostringstream text;
+		writeEntries(text, bounds[c], bounds[c + 1]);
+		pieces[c - first].clear();
+		if (compression == SDPA_PLAIN) {
+			pieces[c - first] = text.str();
+		} else if (!gzipCompress(text.str(), pieces[c - first])) {
+			++failed;
+		}
+	}
+	return failed == 0;
+}
+
+/**
+ * Helper function to get the number of chunks formatted at a time.
+ */
+static int getChunkBatch() {
+	int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	return SDPA_CHUNKS_PER_THREAD * nThreads;
+}
+
+/**
+ * Write the part of the SDPA file held by this rank: the header if asked
+ * for, and the entries.
+ *
+ * Compressed entries are cut into chunks with getChunkBounds. The chunks
+ * are formatted and compressed as independent gzip members in parallel, a
+ * batch at a time to bound the memory, and written in order. Concatenated
+ * gzip members are a valid gzip stream, so the pieces written by several
+ * ranks also add up to one.
+ *
+ * Returns false if compression failed.
+ */
+bool SdpRelaxation::writeSdpa(ostream &outfile, const char *filename,
+		const bool header, const SdpaCompression compression) {
+	if (compression == SDPA_PLAIN) {
+		if (header) {
+			writeHeader(outfile, filename);
+		}
+		writeEntries(outfile, 0, nElements + 1);
+		return true;
+	}
+	if (header) {
+		StreamPieces pieces(outfile, true);
+		ostream text(&pieces);
+		writeHeader(text, filename);
+		text.flush();
+		if (!pieces.isCompressed()) {
+			return false;
+		}
+	}
+	vector<long long> bounds;
+	getChunkBounds(bounds);
+	int nChunks = bounds.size() - 1;
+	int batch = getChunkBatch();
+	vector<string> members(batch);
+	bool compressed = true;
+	for (int first = 0; first < nChunks; first += batch) {
+		int last = min(first + batch, nChunks);
+		compressed = formatChunks(bounds, first, last, compression, members)
+				&& compressed;
+		for (int c = first; c < last; ++c) {
+			outfile.write(members[c - first].data(), members[c - first].size());
+		}
+	}
+	return compressed;
+}
+
+/**
+ * Helper function to close a file written with an ofstream and report if
+ * any of it could not be written.
+ */
+static bool closeFile(ofstream &outfile, const string &filename) {
 	outfile.close();
+	if (outfile.fail()) {
+		cerr << "Cannot write " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Helper function to check that a relaxation can be written in the given
+ * format.
+ */
+static bool canWrite(const BuildStatus status,
+		const SdpaCompression compression, const int rank) {
+	if (status != BUILD_DONE) {
+		if (rank == 0) {
+			cerr << "No relaxation to write" << endl;
+		}
+		return false;
+	}
+#ifndef HAVE_ZLIB
+	if (compression == SDPA_GZIP) {
+		if (rank == 0) {
+			cerr << "Compressed output needs zlib" << endl;
+		}
+		return false;
+	}
+#endif
+	return true;
+}
+
+/** Write an SDP relaxation to SDPA format
+ * 
+ * If the relaxation is distributed, the ranks write their own entries to a
+ * single file with MPI-IO. They take turns a batch of chunks at a time, so
+ * the entries of the ranks are interleaved in the file.
+ *
+ * Returns false if there is no relaxation to write, or if the file could
+ * not be written in full on any rank.
+ *
+ * @param filename - the name of the file
+ * @param compression - SDPA_GZIP to compress the file with gzip, in
+ *                      chunks compressed in parallel
+ */
+bool SdpRelaxation::writeToSdpa(const char *filename,
+		const SdpaCompression compression) {
+	if (!canWrite(control.getStatus(), compression, rank)) {
+		return false;
+	}
+	if (verbose && rank == 0) {
+		cout << "writing problem in " << filename << endl;
+	}
+#ifdef HAVE_MPI
+	if (nRanks > 1) {
+		MPI_File file = MPI_FILE_NULL;
+		int opened = MPI_File_open(getComm(communicator),
+				const_cast<char *>(filename),
+				MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file)
+				== MPI_SUCCESS;
+    // The file is set up collectively, so every rank has to have it open
+		MPI_Allreduce(MPI_IN_PLACE, &opened, 1, MPI_INT, MPI_MIN,
+				getComm(communicator));
+		if (!opened) {
+			if (rank == 0) {
+				cerr << "Cannot open " << filename << endl;
+			}
+			if (file != MPI_FILE_NULL) {
+				MPI_File_close(&file);
+			}
+			return false;
+		}
+		MPI_File_set_size(file, 0);
+		MPI_Barrier(getComm(communicator));
+		int written = 1, compressed = 1;
+		long long base = 0;
+		if (rank == 0) {
+			MpiFilePieces pieces(file, 0, compression == SDPA_GZIP);
+			ostream text(&pieces);
+			writeHeader(text, filename);
+			text.flush();
+			written = pieces.isWritten();
+			compressed = pieces.isCompressed();
+			base = pieces.getOffset();
+		}
+		MPI_Bcast(&base, 1, MPI_LONG_LONG, 0, getComm(communicator));
+    // Every round each rank formats its next batch of chunks and writes it
+    // after the batches of the lower ranks, so the memory stays bounded
+		vector<long long> bounds;
+		getChunkBounds(bounds);
+		int nChunks = bounds.size() - 1;
+		int batch = getChunkBatch();
+		int nRounds = agreeRounds((nChunks + batch - 1) / batch, nRanks,
+				communicator);
+		vector<string> pieces(batch);
+		for (int round = 0; round < nRounds; ++round) {
+			int first = min(round * batch, nChunks);
+			int last = min(first + batch, nChunks);
+			if (!formatChunks(bounds, first, last, compression, pieces)) {
+				compressed = 0;
+			}
+			long long size = 0, offset = 0, total = 0;
+			for (int c = first; c < last; ++c) {
+				size += pieces[c - first].size();
+			}
+			MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM,
+					getComm(communicator));
+			MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM,
+					getComm(communicator));
+			if (rank == 0) {
+				offset = 0;
+			}
+			for (int c = first; c < last && written; ++c) {
+				written = writeAt(file, base + offset, pieces[c - first].data(),
+						pieces[c - first].size());
+				offset += pieces[c - first].size();
+			}
+			base += total;
+		}
+		if (!compressed) {
+			cerr << "Compression failed" << endl;
+		}
+		if (!written) {
+			cerr << "Cannot write " << filename << endl;
+		}
+		written = written && compressed;
+		MPI_File_close(&file);
+		MPI_Allreduce(MPI_IN_PLACE, &written, 1, MPI_INT, MPI_MIN,
+				getComm(communicator));
+		return written;
+	}
+#endif
+	ofstream outfile(filename, ios::binary);
+	if (!outfile) {
+		cerr << "Cannot open " << filename << endl;
+		return false;
+	}
+	bool written = writeSdpa(outfile, filename, true, compression);
+	if (!written) {
+		cerr << "Compression failed" << endl;
+	}
+	return closeFile(outfile, filename) && written;
+}
+
+/** Write an SDP relaxation to SDPA format as one shard per MPI rank. The
+ * first shard contains the header, and concatenating the shards in the
+ * order of the ranks gives a file with the same entries as writeToSdpa.
+ *
+ * Returns false if there is no relaxation to write, or if the shard of
+ * this rank could not be written in full.
+ *
+ * @param filename - the name of the file, the shards are named
+ *                   filename.0, filename.1, ...
+ * @param compression - SDPA_GZIP to compress every shard with gzip
+ */
+bool SdpRelaxation::writeToSdpaShards(const char *filename,
+		const SdpaCompression compression) {
+	if (!canWrite(control.getStatus(), compression, rank)) {
+		return false;
+	}
+	ostringstream shardname;
+	shardname << filename << "." << rank;
+	if (verbose && rank == 0) {
+		cout << "writing problem in " << nRanks << " shards of " << filename
+				<< endl;
+	}
+	ofstream outfile(shardname.str().c_str(), ios::binary);
+	if (!outfile) {
+		cerr << "Cannot open " << shardname.str() << endl;
+		return false;
+	}
+	bool written = writeSdpa(outfile, filename, rank == 0, compression);
+	if (!written) {
+		cerr << "Compression failed" << endl;
+	}
+	return closeFile(outfile, shardname.str()) && written;
 }
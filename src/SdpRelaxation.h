@@ -21,14 +21,22 @@
 
 #include <iostream>
 #include <unordered_map>
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
 #include "symbolicc++.h"
 #include "ncUtils.h"
+#include "MonomialTable.h"
+#include "Arena.h"
+#include "SparsePolynomial.h"
+#include "Algebra.h"
+#include "SymmetryGroup.h"
+#include "BuildControl.h"
+#include "Compression.h"
 
 #ifndef SDP_RELAXATION
 #define SDP_RELAXATION
 
-typedef pair<int, int> Index;
-
 struct Entry {
 
 	int blockIndex;
@@ -38,34 +46,170 @@ struct Entry {
 
 };
 
+typedef list<Entry, ArenaAllocator<Entry> > EntryList;
+
+/**
+ * A position of the moment matrix as sent to the rank that numbers the
+ * variables of its range in a distributed relaxation: either a position
+ * that holds entries, with a negative term, or term number term of the
+ * objective function with its coefficient.
+ */
+struct PositionRecord {
+
+	long long position;
+	int term;
+	double coefficient;
+
+};
+
+// Terms of a polynomial as pairs of a coefficient and a monomial
+typedef vector<pair<double, Symbolic> > Terms;
+
 class SdpRelaxation {
 
+	friend class RelaxationBuild;
+
 private:
 	const unordered_map<Symbolic, Symbolic, hashMonomial> substitutions;
-	unordered_map<Symbolic, Index, hashMonomial> monomialDictionary;
+	const Algebra *algebra;
+	const SymmetryGroup *symmetry;
+	const vector<Symbolic> *basis;
+	bool verbose;
+	unordered_map<Symbolic, unsigned int, hashMonomial> letters;
+	MonomialTable monomialDictionary;
+	int rank;
+	int nRanks;
+	// The MPI communicator of a distributed relaxation, NULL if it is built
+	// by this process alone. It is held through a pointer so that the
+	// layout of the class does not depend on HAVE_MPI.
+	void *communicator;
 	int nMonomials;
-	int nElements;
+	long long nElements;
+	long long nVariables;
+	// SDP variable of each position, zero if no moment is stored there
+	vector<long long> variableIndex;
 	vector<int> blockStruct;
 	double *objFacVar;
-	list<Entry> *F;
+	// Bytes of the buffers of the block of rows at hand
+	size_t blockBytes;
+	// The arenas must outlive the entries allocated from them
+	ArenaPool arenas;
+	vector<EntryList> F;
+	BuildControl control;
+	// Buffers of each OpenMP thread, reused from one word or entry to the
+	// next so that the loops over the matrix elements do not allocate
+	struct Scratch {
+		vector<unsigned int> indices;
+		Word word;
+		vector<pair<long long, double> > moments;
+	};
+	vector<Scratch> scratch;
+	// A distributed relaxation keeps the entries of its own rows with their
+	// positions, and numbers only the positions it holds
+	vector<pair<long long, Entry> > localEntries;
+	vector<long long> localPositions;
+	vector<long long> localVariables;
+	// The terms of the objective function of a distributed relaxation, and
+	// its nonzero coefficients by variable, gathered on the first rank
+	vector<PositionRecord> objectiveTerms;
+	vector<pair<long long, double> > objectiveCoefficients;
+	// A moment of an element of a localizing matrix of a distributed
+	// relaxation, whose position is looked up later
+	struct MomentTerm {
+		int column;
+		Word word;
+		double value;
+		int id;
+	};
 
 	Symbolic applySubstitution(Symbolic monomial);
-	vector<Symbolic> getNcMonomials(const Symbolic variables, short int degree);
-	double *getFacVar(const Symbolic polynomial);
-	void generateMomentMatrix(const vector<Symbolic> monomials, int *blockIndex);
-	void processInequalities(const vector<Symbolic> inequalities,
-			const vector<Symbolic> monomials, const int blockIndex, const int order);
-	void pushFacVarSparse(const Symbolic polynomial, const int blockIndex,
-			const int i, const int j);
+	void getWord(const Symbolic monomial, Word &word, int *sign);
+	Scratch &getScratch();
+	void getMomentWord(const Symbolic monomial, Word &word, double *coeff);
+	long long getMomentIndex(const Symbolic monomial, double *coeff);
+	double *getFacVar(const Terms &polynomial);
+	void getDistributedObjective(const Terms &polynomial);
+	void getMomentWords(const vector<Symbolic> &monomials, const int row,
+			const int column, Word &word, int *sign, Word &word_dagger,
+			int *sign_dagger);
+	void pushEntry(const long long k, const Entry &entry);
+	void pushMomentEntries(const int blockIndex, const int row,
+			const int column, const Index index, const int sign,
+			const Index index_dagger, const int sign_dagger);
+	void generateMomentMatrix(const vector<Symbolic> &monomials,
+			int *blockIndex);
+	void generateDistributedMomentMatrix(const vector<Symbolic> &monomials,
+			const int blockIndex);
+	void exchangeDictionary(const vector<pair<Word, Index> > &localWords);
+	void resolveWords(const vector<Word> &words, const size_t begin,
+			const size_t end, vector<Index> &indices);
+	void processInequalities(const vector<Terms> &inequalities,
+			const vector<Symbolic> &monomials, const int blockIndex,
+			const int order);
+	void getFacVarSparse(const Terms &polynomial,
+			const vector<Symbolic> &monomials, const int blockIndex,
+			const int row, const int column,
+			vector<pair<long long, Entry> > &entries);
+	void getMomentTerms(const Terms &polynomial,
+			const vector<Symbolic> &monomials, const int row, const int column,
+			vector<MomentTerm> &terms);
+	void processDistributedInequalities(const vector<Terms> &inequalities,
+			const vector<Symbolic> &monomials, const int blockIndex,
+			const int nIneqMonomials, const vector<int> &rows);
+	void generateRelaxation(const Symbolic variables, const Terms &objective,
+			vector<Terms> inequalities, const vector<Terms> &equalities,
+			const short int order);
+	bool planMemory(const vector<Symbolic> &monomials,
+			size_t *dictionaryReserve);
+	bool rowDone(const long long elements);
+	bool blockDone(const size_t bufferBytes);
+	void setConstraintUsage();
+	void finishBuild();
+	void releaseRelaxation();
+	void numberVariables();
+	void numberDistributedVariables();
+	void writeHeader(ostream &outfile, const char *filename);
+	void writeEntries(ostream &outfile, const long long begin,
+			const long long end);
+	void getChunkBounds(vector<long long> &bounds);
+	bool formatChunks(const vector<long long> &bounds, const int first,
+			const int last, const SdpaCompression compression,
+			vector<string> &pieces);
+	bool writeSdpa(ostream &outfile, const char *filename, const bool header,
+			const SdpaCompression compression);
 
 public:
 	SdpRelaxation(
-			const unordered_map<Symbolic, Symbolic, hashMonomial> substitutions);
+			const unordered_map<Symbolic, Symbolic, hashMonomial> substitutions,
+			const Algebra *algebra = NULL,
+			const SymmetryGroup *symmetry = NULL);
 	~SdpRelaxation();
 	void getRelaxation(const Symbolic variables, const Symbolic objective,
 			vector<Symbolic> inequalities, const vector<Symbolic> equalities,
 			const short int order);
-	void writeToSdpa(const char *filename);
+	void getRelaxation(const Symbolic variables,
+			const SparsePolynomial &objective,
+			const vector<SparsePolynomial> &inequalities,
+			const vector<SparsePolynomial> &equalities, const short int order);
+	void getRelaxation(const Symbolic variables, const SparseProblem &problem,
+			const short int order);
+	static vector<Symbolic> getNcMonomials(const Symbolic variables,
+			short int degree);
+	void setBasis(const vector<Symbolic> *basis);
+#ifdef HAVE_MPI
+	void setCommunicator(MPI_Comm comm);
+#endif
+	void setVerbose(const bool verbose);
+	void setBudget(const BuildBudget &budget);
+	void setProgressCallback(ProgressCallback callback, void *data);
+	BuildProgress getProgress() const;
+	BuildStatus getStatus() const;
+	MemoryUsage getMemoryUsage() const;
+	void cancel();
+	bool writeToSdpa(const char *filename,
+			const SdpaCompression compression = SDPA_PLAIN);
+	bool writeToSdpaShards(const char *filename,
+			const SdpaCompression compression = SDPA_PLAIN);
 };
 
 #endif
@@ -0,0 +1,230 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "SdpaReader.h"
+
+// Size of the pieces a long line is read in
+#define LINE_BUFFER_SIZE 65536
+
+struct SdpaFile {
+#ifdef HAVE_ZLIB
+	gzFile stream;
+#else
+	ifstream stream;
+#endif
+};
+
+SdpaReader::SdpaReader() :
+		file(NULL), malformed(false), nVars(0) {
+}
+
+SdpaReader::~SdpaReader() {
+	close();
+}
+
+/**
+ * Read the next line into the line buffer, without the newline. Lines of
+ * any length are read, which matters for the objective function.
+ *
+ * Returns false at the end of the file.
+ */
+bool SdpaReader::readLine() {
+	line.clear();
+	if (file == NULL) {
+		return false;
+	}
+#ifdef HAVE_ZLIB
+	char buffer[LINE_BUFFER_SIZE];
+	while (gzgets(file->stream, buffer, LINE_BUFFER_SIZE) != NULL) {
+		size_t length = strlen(buffer);
+		if (length > 0 && buffer[length - 1] == '\n') {
+			line.append(buffer, length - 1);
+			return true;
+		}
+		line.append(buffer, length);
+	}
+	return !line.empty();
+#else
+	return !getline(file->stream, line).fail();
+#endif
+}
+
+/**
+ * Helper function to parse all the numbers on a line, skipping any
+ * punctuation between them.
+ */
+template<class T>
+static vector<T> parseNumbers(const string &line) {
+	vector<T> numbers;
+	const char *p = line.c_str();
+	char *end;
+	while (*p != '\0') {
+		if (strchr("0123456789+-.", *p) == NULL) {
+			++p;
+			continue;
+		}
+		double number = strtod(p, &end);
+		if (end == p) {
+			++p;
+			continue;
+		}
+		numbers.push_back((T) number);
+		p = end;
+	}
+	return numbers;
+}
+
+/**
+ * Open a file and read its header: the number of variables, the block
+ * structure and the objective function.
+ *
+ * Returns false if the file cannot be opened or the header is malformed.
+ */
+bool SdpaReader::open(const char *filename) {
+	close();
+	file = new SdpaFile;
+#ifdef HAVE_ZLIB
+	file->stream = gzopen(filename, "rb");
+	if (file->stream == NULL) {
+#else
+	file->stream.open(filename);
+	if (!file->stream) {
+#endif
+		cerr << "Cannot open " << filename << endl;
+		close();
+		return false;
+	}
+	// Skip the comment lines
+	do {
+		if (!readLine()) {
+			cerr << filename << ": no header" << endl;
+			return false;
+		}
+	} while (line.empty() || line[0] == '"' || line[0] == '*');
+	nVars = atoll(line.c_str());
+	int nBlocks = 0;
+	if (readLine()) {
+		nBlocks = atoi(line.c_str());
+	}
+	if (readLine()) {
+		blockStruct = parseNumbers<int>(line);
+	}
+	if (readLine()) {
+		objective = parseNumbers<double>(line);
+	}
+	if ((int) blockStruct.size() != nBlocks
+			|| (int) objective.size() != nVars) {
+		cerr << filename << ": malformed header" << endl;
+		return false;
+	}
+	return true;
+}
+
+void SdpaReader::close() {
+	if (file != NULL) {
+#ifdef HAVE_ZLIB
+		if (file->stream != NULL) {
+			gzclose(file->stream);
+		}
+#endif
+		delete file;
+		file = NULL;
+	}
+	malformed = false;
+	nVars = 0;
+	blockStruct.clear();
+	objective.clear();
+}
+
+/**
+ * Helper function to parse an integer field of an entry and move past it.
+ * Returns false if there is no integer.
+ */
+static bool parseField(const char **p, long long *field) {
+	char *end;
+	*field = strtoll(*p, &end, 10);
+	if (end == *p) {
+		return false;
+	}
+	*p = end;
+	return true;
+}
+
+/**
+ * Read the next entry of the constraint matrices. Every field is checked,
+ * and the variable, the block, the row and the column must lie within the
+ * header.
+ *
+ * Returns false at the end of the file or on a malformed line, which
+ * isMalformed then tells apart.
+ */
+bool SdpaReader::nextEntry(long long *k, int *blockIndex, int *row,
+		int *column, double *value) {
+	do {
+		if (!readLine()) {
+			return false;
+		}
+	} while (line.empty());
+	const char *p = line.c_str();
+	char *end;
+	long long block, i, j;
+	bool valid = parseField(&p, k) && parseField(&p, &block)
+			&& parseField(&p, &i) && parseField(&p, &j);
+	if (valid) {
+		*value = strtod(p, &end);
+		valid = end != p;
+		p = end;
+	}
+	while (isspace(*p)) {
+		++p;
+	}
+	valid = valid && *p == '\0' && *k >= 0 && *k <= nVars && block >= 1
+			&& block <= (long long) blockStruct.size();
+	if (valid) {
+		long long size = abs(blockStruct[block - 1]);
+		valid = i >= 1 && i <= size && j >= 1 && j <= size;
+	}
+	if (!valid) {
+		cerr << "Malformed entry: " << line << endl;
+		malformed = true;
+		return false;
+	}
+	*blockIndex = block;
+	*row = i;
+	*column = j;
+	return true;
+}
+
+/**
+ * Returns true if reading stopped on a malformed line rather than at the
+ * end of the file.
+ */
+bool SdpaReader::isMalformed() const {
+	return malformed;
+}
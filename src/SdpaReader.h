@@ -0,0 +1,67 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#ifndef SDPA_READER
+#define SDPA_READER
+
+using namespace std;
+
+// The open file, a gzip stream with zlib and a plain stream without. It is
+// only defined in SdpaReader.cpp, so that the layout of the reader does not
+// depend on how the library was configured.
+struct SdpaFile;
+
+/**
+ * Streaming reader of sparse SDPA files as written by SdpRelaxation. The
+ * header is read when the file is opened, and the entries are then read
+ * one at a time, so that files much larger than the memory can be
+ * processed. With zlib, gzip-compressed files are decompressed on the
+ * fly and plain files are read as they are.
+ */
+class SdpaReader {
+
+private:
+	SdpaFile *file;
+	string line;
+	bool malformed;
+
+	bool readLine();
+
+public:
+	long long nVars;
+	vector<int> blockStruct;
+	vector<double> objective;
+
+	SdpaReader();
+	~SdpaReader();
+	SdpaReader(const SdpaReader &) = delete;
+	SdpaReader &operator=(const SdpaReader &) = delete;
+	bool open(const char *filename);
+	void close();
+	bool nextEntry(long long *k, int *blockIndex, int *row, int *column,
+			double *value);
+	bool isMalformed() const;
+};
+
+#endif
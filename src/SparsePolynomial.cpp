@@ -0,0 +1,261 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "SparsePolynomial.h"
+
+#define BINARY_MAGIC "NCPB"
+
+void SparsePolynomial::addTerm(const double coefficient,
+		const vector<unsigned int> &word) {
+	Term term;
+	term.coefficient = coefficient;
+	term.word = word;
+	terms.push_back(term);
+}
+
+void SparsePolynomial::addTerm(const double coefficient) {
+	addTerm(coefficient, vector<unsigned int>());
+}
+
+void SparsePolynomial::addTerm(const double coefficient, const unsigned int i) {
+	addTerm(coefficient, vector<unsigned int>(1, i));
+}
+
+void SparsePolynomial::addTerm(const double coefficient, const unsigned int i,
+		const unsigned int j) {
+	vector<unsigned int> word(2, i);
+	word[1] = j;
+	addTerm(coefficient, word);
+}
+
+/**
+ * Helper function to find the size of a file opened for reading, leaving
+ * the stream at the beginning.
+ */
+static size_t getFileSize(ifstream &infile) {
+	infile.seekg(0, ios::end);
+	streamoff size = infile.tellg();
+	infile.seekg(0, ios::beg);
+	return size > 0 ? size : 0;
+}
+
+/**
+ * The terms read from a file so far. The constraints are kept by their
+ * index in the file, so that only indices with terms take memory.
+ */
+struct ProblemTerms {
+
+	SparsePolynomial objective;
+	map<unsigned int, SparsePolynomial> inequalities;
+	map<unsigned int, SparsePolynomial> equalities;
+};
+
+/**
+ * Helper function to find the polynomial a term read from a file belongs to.
+ * Returns NULL if the kind is not known.
+ */
+static SparsePolynomial *getPolynomial(ProblemTerms &read, const char kind,
+		const unsigned int k) {
+	if (kind == 'o') {
+		return &read.objective;
+	} else if (kind == 'i') {
+		return &read.inequalities[k];
+	} else if (kind == 'e') {
+		return &read.equalities[k];
+	}
+	return NULL;
+}
+
+/**
+ * Helper function to number the constraints read from a file consecutively
+ * in the order of their indices.
+ */
+static void numberConstraints(map<unsigned int, SparsePolynomial> &read,
+		vector<SparsePolynomial> &constraints) {
+	constraints.clear();
+	constraints.reserve(read.size());
+	for (map<unsigned int, SparsePolynomial>::iterator c = read.begin();
+			c != read.end(); ++c) {
+		constraints.push_back(SparsePolynomial());
+		constraints.back().terms.swap(c->second.terms);
+	}
+}
+
+/**
+ * Helper function to replace a problem with the terms read from a file.
+ */
+static void storeProblem(ProblemTerms &read, SparseProblem &problem) {
+	problem.objective.terms.swap(read.objective.terms);
+	numberConstraints(read.inequalities, problem.inequalities);
+	numberConstraints(read.equalities, problem.equalities);
+}
+
+/**
+ * Read a problem from a file, in the binary format if the file starts with
+ * the magic bytes, and in the text format otherwise.
+ */
+bool SparseProblem::read(const char *filename) {
+	ifstream infile(filename, ios::binary);
+	if (!infile) {
+		cerr << "Cannot open " << filename << endl;
+		return false;
+	}
+	char magic[4] = { 0, 0, 0, 0 };
+	infile.read(magic, 4);
+	infile.close();
+	if (memcmp(magic, BINARY_MAGIC, 4) == 0) {
+		return readBinary(filename);
+	}
+	return readText(filename);
+}
+
+bool SparseProblem::readText(const char *filename) {
+	ifstream infile(filename);
+	if (!infile) {
+		cerr << "Cannot open " << filename << endl;
+		return false;
+	}
+	ProblemTerms read;
+	string line;
+	int lineNumber = 0;
+	while (getline(infile, line)) {
+		++lineNumber;
+		istringstream tokens(line);
+		char kind;
+		if (!(tokens >> kind) || kind == '#') {
+			continue;
+		}
+		unsigned int k = 0;
+		if (kind != 'o' && !(tokens >> k)) {
+			kind = 0;
+		}
+		Term term;
+		SparsePolynomial *polynomial = getPolynomial(read, kind, k);
+		if (polynomial == NULL || !(tokens >> term.coefficient)) {
+			cerr << filename << ":" << lineNumber << ": not a term: " << line
+					<< endl;
+			return false;
+		}
+		unsigned int letter;
+		while (tokens >> letter) {
+			term.word.push_back(letter);
+		}
+		if (!tokens.eof()) {
+			cerr << filename << ":" << lineNumber << ": not a term: " << line
+					<< endl;
+			return false;
+		}
+		polynomial->terms.push_back(term);
+	}
+	storeProblem(read, *this);
+	return true;
+}
+
+bool SparseProblem::readBinary(const char *filename) {
+	ifstream infile(filename, ios::binary);
+	size_t size = getFileSize(infile);
+	ProblemTerms read;
+	char magic[4];
+	if (!infile.read(magic, 4) || memcmp(magic, BINARY_MAGIC, 4) != 0) {
+		cerr << filename << " is not a binary problem file" << endl;
+		return false;
+	}
+	char kind;
+	while (infile.read(&kind, 1)) {
+		uint32_t k, length;
+		Term term;
+		infile.read(reinterpret_cast<char *>(&k), sizeof(k));
+		infile.read(reinterpret_cast<char *>(&term.coefficient),
+				sizeof(term.coefficient));
+		infile.read(reinterpret_cast<char *>(&length), sizeof(length));
+		if (!infile) {
+			cerr << filename << ": truncated record" << endl;
+			return false;
+		}
+		size_t remaining = size - (size_t) infile.tellg();
+		if (length > remaining / sizeof(uint32_t)) {
+			cerr << filename << ": truncated record" << endl;
+			return false;
+		}
+		vector<uint32_t> letters(length);
+		if (length > 0
+				&& !infile.read(reinterpret_cast<char *>(&letters[0]),
+						length * sizeof(uint32_t))) {
+			cerr << filename << ": truncated record" << endl;
+			return false;
+		}
+		term.word.assign(letters.begin(), letters.end());
+		SparsePolynomial *polynomial = getPolynomial(read, kind, k);
+		if (polynomial == NULL) {
+			cerr << filename << ": unknown record kind " << (int) kind << endl;
+			return false;
+		}
+		polynomial->terms.push_back(term);
+	}
+	storeProblem(read, *this);
+	return true;
+}
+
+/**
+ * Helper function to write the terms of a polynomial as binary records.
+ */
+static void writeRecords(ofstream &outfile, const char kind,
+		const uint32_t k, const SparsePolynomial &polynomial) {
+	for (vector<Term>::const_iterator term = polynomial.terms.begin();
+			term != polynomial.terms.end(); ++term) {
+		uint32_t length = term->word.size();
+		vector<uint32_t> letters(term->word.begin(), term->word.end());
+		outfile.write(&kind, 1);
+		outfile.write(reinterpret_cast<const char *>(&k), sizeof(k));
+		outfile.write(reinterpret_cast<const char *>(&term->coefficient),
+				sizeof(term->coefficient));
+		outfile.write(reinterpret_cast<const char *>(&length), sizeof(length));
+		if (length > 0) {
+			outfile.write(reinterpret_cast<const char *>(&letters[0]),
+					length * sizeof(uint32_t));
+		}
+	}
+}
+
+bool SparseProblem::writeBinary(const char *filename) const {
+	ofstream outfile(filename, ios::binary);
+	if (!outfile) {
+		cerr << "Cannot open " << filename << endl;
+		return false;
+	}
+	outfile.write(BINARY_MAGIC, 4);
+	writeRecords(outfile, 'o', 0, objective);
+	for (uint32_t k = 0; k < inequalities.size(); ++k) {
+		writeRecords(outfile, 'i', k, inequalities[k]);
+	}
+	for (uint32_t k = 0; k < equalities.size(); ++k) {
+		writeRecords(outfile, 'e', k, equalities[k]);
+	}
+	outfile.close();
+	return !outfile.fail();
+}
@@ -0,0 +1,93 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+
+#ifndef SPARSE_POLYNOMIAL
+#define SPARSE_POLYNOMIAL
+
+using namespace std;
+
+/**
+ * A term of a polynomial: a coefficient and a word of variable indices,
+ * where index i stands for the ith noncommutative variable. An empty word is
+ * the constant term.
+ */
+struct Term {
+
+	double coefficient;
+	vector<unsigned int> word;
+
+};
+
+/**
+ * A polynomial given as a plain list of terms. Adding a term is constant
+ * time, there is no symbolic simplification; terms with the same word are
+ * merged when the relaxation is generated.
+ */
+class SparsePolynomial {
+
+public:
+	vector<Term> terms;
+
+	void addTerm(const double coefficient, const vector<unsigned int> &word);
+	void addTerm(const double coefficient);
+	void addTerm(const double coefficient, const unsigned int i);
+	void addTerm(const double coefficient, const unsigned int i,
+			const unsigned int j);
+};
+
+/**
+ * An objective function with inequality and equality constraints, as read
+ * from a file.
+ *
+ * In the text format every line is a term, blank lines and lines starting
+ * with # are skipped:
+ *
+ *   o <coefficient> <variable> <variable> ...      term of the objective
+ *   i <k> <coefficient> <variable> <variable> ...  term of inequality k
+ *   e <k> <coefficient> <variable> <variable> ...  term of equality k
+ *
+ * The binary format starts with the magic bytes NCPB followed by records of
+ * a char kind ('o', 'i' or 'e'), a uint32 constraint index, a double
+ * coefficient, a uint32 word length and the uint32 letters of the word, all
+ * in native byte order.
+ *
+ * The indices only group and order the terms of the constraints: the
+ * constraints read are numbered consecutively in the order of their
+ * indices, and an index without terms is no constraint. Reading fails on a
+ * word length larger than the file has room for, rather than allocating
+ * for it. A problem that is read replaces the one held.
+ */
+class SparseProblem {
+
+public:
+	SparsePolynomial objective;
+	vector<SparsePolynomial> inequalities;
+	vector<SparsePolynomial> equalities;
+
+	bool read(const char *filename);
+	bool readText(const char *filename);
+	bool readBinary(const char *filename);
+	bool writeBinary(const char *filename) const;
+};
+
+#endif
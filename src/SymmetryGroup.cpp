@@ -0,0 +1,122 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <iostream>
+#include <set>
+#include "SymmetryGroup.h"
+
+/**
+ * Helper function to check that a generator is a permutation of the
+ * variable indices 0, 1, ..., n-1.
+ */
+static bool isPermutation(const vector<unsigned int> &permutation) {
+	vector<bool> seen(permutation.size(), false);
+	for (size_t i = 0; i < permutation.size(); ++i) {
+		if (permutation[i] >= permutation.size() || seen[permutation[i]]) {
+			return false;
+		}
+		seen[permutation[i]] = true;
+	}
+	return true;
+}
+
+/**
+ * Close the group generated by a set of permutations.
+ *
+ * Arguments:
+ * @param generators - permutations of the variable indices, where
+ *                     generator[i] is the image of variable i. Variables
+ *                     beyond the length of a generator are left fixed.
+ */
+SymmetryGroup::SymmetryGroup(const vector<vector<unsigned int> > &generators) :
+		nVars(0) {
+	vector<vector<unsigned int> > valid;
+	for (size_t g = 0; g < generators.size(); ++g) {
+		if (!isPermutation(generators[g])) {
+			cerr << "Generator " << g << " is not a permutation" << endl;
+			continue;
+		}
+		valid.push_back(generators[g]);
+		if (generators[g].size() > nVars) {
+			nVars = generators[g].size();
+		}
+	}
+	// Extend the generators to act on the same number of variables
+	for (size_t g = 0; g < valid.size(); ++g) {
+		for (unsigned int i = valid[g].size(); i < nVars; ++i) {
+			valid[g].push_back(i);
+		}
+	}
+	// Breadth-first closure, starting from the identity
+	vector<unsigned int> identity(nVars);
+	for (unsigned int i = 0; i < nVars; ++i) {
+		identity[i] = i;
+	}
+	set<vector<unsigned int> > seen;
+	seen.insert(identity);
+	elements.push_back(identity);
+	for (size_t e = 0; e < elements.size(); ++e) {
+		for (size_t g = 0; g < valid.size(); ++g) {
+			vector<unsigned int> product(nVars);
+			for (unsigned int i = 0; i < nVars; ++i) {
+				product[i] = valid[g][elements[e][i]];
+			}
+			if (seen.insert(product).second) {
+				elements.push_back(product);
+			}
+		}
+	}
+}
+
+size_t SymmetryGroup::order() const {
+	return elements.size();
+}
+
+/**
+ * Replace a word in normal form by the smallest word of its orbit. Every
+ * image is brought to normal form again with the algebra, if any, since a
+ * permutation may break the ordering of the letters.
+ *
+ * Returns the sign picked up by the normal ordering of the representative.
+ */
+int SymmetryGroup::canonicalize(vector<unsigned int> &word,
+		const Algebra *algebra) const {
+	vector<unsigned int> best = word, image(word.size());
+	int bestSign = 1;
+	// The first element is the identity
+	for (size_t e = 1; e < elements.size(); ++e) {
+		const vector<unsigned int> &permutation = elements[e];
+		image.resize(word.size());
+		for (size_t i = 0; i < word.size(); ++i) {
+			image[i] = word[i] < nVars ? permutation[word[i]] : word[i];
+		}
+		int sign = 1;
+		if (algebra != NULL) {
+			sign = algebra->normalOrder(image);
+		}
+		if (image < best) {
+			best = image;
+			bestSign = sign;
+		}
+	}
+	word.swap(best);
+	return bestSign;
+}
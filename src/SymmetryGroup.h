@@ -0,0 +1,52 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <vector>
+#include "Algebra.h"
+
+#ifndef SYMMETRY_GROUP
+#define SYMMETRY_GROUP
+
+using namespace std;
+
+/**
+ * A group of permutations of the noncommutative variables, for instance the
+ * translations and reflections of the sites of a lattice. The group is
+ * closed from its generators and every element is kept, so it is meant for
+ * groups of moderate order.
+ *
+ * If the objective function and the constraints are invariant under the
+ * group, the moments of a whole orbit can be merged into a single SDP
+ * variable, keyed by the smallest word of the orbit.
+ */
+class SymmetryGroup {
+
+private:
+	unsigned int nVars;
+	vector<vector<unsigned int> > elements;
+
+public:
+	SymmetryGroup(const vector<vector<unsigned int> > &generators);
+	size_t order() const;
+	int canonicalize(vector<unsigned int> &word, const Algebra *algebra) const;
+};
+
+#endif
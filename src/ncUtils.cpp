@@ -28,7 +28,8 @@
 Symbolic conjugate(const Symbolic monomial) {
 	Symbolic result = Symbolic(1);
 	if (monomial.type() == typeid(Product)) {
-		list<Symbolic> factors = CastPtr<const Product>(monomial)->factors;
+		CastPtr<const Product> product = monomial;
+		const list<Symbolic> &factors = product->factors;
 		list<Symbolic>::const_iterator i = factors.end();
 		for (i--; i != factors.end(); --i) {
 			result *= *i;
@@ -64,7 +65,8 @@ Symbolic fastSubstitute(Symbolic monomial, Symbolic oldSub, Symbolic newSub) {
 		bool changed = false;
 		list<Symbolic> result;
 		Symbolic remainder;
-		list<Symbolic> factors = CastPtr<const Product>(monomial)->factors;
+		CastPtr<const Product> product = monomial;
+		const list<Symbolic> &factors = product->factors;
 		list<Symbolic>::const_iterator factor = factors.begin();
 		while ( factor != factors.end()) {
 			if (!isOldSubProduct){
@@ -168,7 +170,8 @@ Symbolic fastSubstitute(Symbolic monomial, Symbolic oldSub, Symbolic newSub) {
 int ncDegree(const Symbolic monomial) {
 	int degree = 0;
 	if (monomial.type() == typeid(Product)) {
-		list<Symbolic> factors = CastPtr<const Product>(monomial)->factors;
+		CastPtr<const Product> product = monomial;
+		const list<Symbolic> &factors = product->factors;
 		for (list<Symbolic>::const_iterator i = factors.begin();
 				i != factors.end(); ++i) {
 			if ((*i).type() == typeid(Power)) {
@@ -232,11 +235,11 @@ vector<Symbolic> unique(const list<Symbolic> l) {
 	return result;
 }
 
-int index2linear(const int i, const int j, const int nMonomials) {
+long long index2linear(const int i, const int j, const int nMonomials) {
 	if (i == 0) {
 		return j + 1;
 	}
-  return i * nMonomials + j + 1;
+  return (long long) i * nMonomials + j + 1;
 }
 
 /**
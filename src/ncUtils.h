@@ -36,7 +36,7 @@ Symbolic conjugate(const Symbolic monomial);
 int countNcMonomials(const vector<Symbolic> monomials, const short int degree);
 Symbolic fastSubstitute(Symbolic monomial, Symbolic oldSub, Symbolic newSub);
 double getCoefficient(const Symbolic monomial);
-int index2linear(const int i, const int j, const int nMonomials);
+long long index2linear(const int i, const int j, const int nMonomials);
 int ncDegree(const Symbolic monomial);
 vector<Symbolic> unique(const list<Symbolic> l);
 
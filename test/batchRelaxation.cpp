@@ -0,0 +1,52 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*
+ * An example that relaxes a batch of independent problems listed in a
+ * manifest, several at a time. The format of the manifest is described in
+ * BatchDriver.cpp; the problems are in the format of SparseProblem.
+ *
+ */
+
+#include <cstdlib>
+#include "BatchDriver.h"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " manifest [workers]" << endl;
+    return 1;
+  }
+  // Stock SymbolicC++ is not thread-safe, so the jobs are built one at a
+  // time unless asked otherwise
+  int nWorkers = argc > 2 ? atoi(argv[2]) : 1;
+
+  BatchDriver batch;
+  if (!batch.readManifest(argv[1])) {
+    return 1;
+  }
+  size_t nFailed = batch.run(nWorkers);
+  if (nFailed > 0) {
+    cerr << nFailed << " jobs failed" << endl;
+    return 1;
+  }
+  return 0;
+}
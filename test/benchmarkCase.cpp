@@ -28,51 +28,68 @@
  *
  */
 
+#include <cstdlib>
+#include <string>
 #include <sys/time.h>
 #include "SdpRelaxation.h"
 
-int main(void) {
-	short int nVars = 10;
-	short int order = 1;
+int main(int argc, char **argv) {
+#ifdef HAVE_MPI
+  // The relaxation is distributed over the ranks when run under mpirun
+  MPI_Init(&argc, &argv);
+#endif
+	// The number of variables and the order can be given on the command line,
+	// followed by gzip to compress the file
+	short int nVars = argc > 1 ? atoi(argv[1]) : 10;
+	short int order = argc > 2 ? atoi(argv[2]) : 1;
+	SdpaCompression compression =
+			argc > 3 && string(argv[3]) == "gzip" ? SDPA_GZIP : SDPA_PLAIN;
     char filename[] = "benchmark.dat-s";
 
     // Declaring noncommutative variables
 	Symbolic X("X", nVars);
 	X = ~X;
 
-	// Setting objective function
-	Symbolic objective = 0;
+	// Setting objective function. The terms are listed one by one rather
+	// than summed symbolically, which would be quadratic in their number.
+	SparsePolynomial objective;
   for (int i=0; i < nVars; ++i) {
     for (int j=0; j < nVars; ++j) {
-      objective += X(i)*X(j);
+      objective.addTerm(1.0, i, j);
     }
   }
 
 	// Defining inequalities
-	vector<Symbolic> inequalities;
+	vector<SparsePolynomial> inequalities(nVars - 1);
   for (int i=1; i < nVars; ++i) {
-    inequalities.push_back( X(i)*X(i-1) - 0.5);
+    inequalities[i-1].addTerm(1.0, i, i-1);
+    inequalities[i-1].addTerm(-0.5);
   }
 
 	// Defining equalities
-	vector<Symbolic> equalities;
+	vector<SparsePolynomial> equalities;
 
-	// Defining monomial substitutions
+	// The variables are projectors, X(i)*X(i) = X(i); the built-in algebra
+	// reduces the words directly instead of matching substitution rules
 	unordered_map<Symbolic, Symbolic, hashMonomial> substitutions;
-  for (int i=0; i < nVars; ++i) {
-    substitutions[X(i)*X(i)] = X(i);
-  }
+  Projectors projectors;
 
 	// Obtaining relaxation and writing file
   struct timeval start, end;
   gettimeofday(&start, NULL);
-  SdpRelaxation *sdpRelaxation = new SdpRelaxation(substitutions);
+  SdpRelaxation *sdpRelaxation = new SdpRelaxation(substitutions, &projectors);
+#ifdef HAVE_MPI
+  sdpRelaxation->setCommunicator(MPI_COMM_WORLD);
+#endif
   sdpRelaxation->getRelaxation(X, objective, inequalities, equalities, order);
-  sdpRelaxation->writeToSdpa(filename);
+  bool written = sdpRelaxation->writeToSdpa(filename, compression);
   gettimeofday(&end, NULL);
   cout << nVars << " " << end.tv_sec - start.tv_sec << " s"
     << endl;
   delete sdpRelaxation;
+#ifdef HAVE_MPI
+  MPI_Finalize();
+#endif
   
-	return 0;
+	return written ? 0 : 1;
 }
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Checks that a relaxation distributed over one to four ranks writes the same
+# entries as the serial build. The ranks write the entries in a different
+# order, so the files are compared sorted. The launcher can be set in MPIRUN.
+
+MPIRUN=${MPIRUN:-mpirun}
+status=0
+dir=`mktemp -d` || exit 1
+cd "$dir" || exit 1
+for case in "10 1" "6 2"; do
+  "$OLDPWD/benchmarkCase" $case > /dev/null || status=1
+  sort benchmark.dat-s > serial.sorted
+  for np in 1 2 3 4; do
+    rm -f benchmark.dat-s
+    if ! $MPIRUN -np $np "$OLDPWD/benchmarkCase" $case > /dev/null; then
+      echo "benchmarkCase $case failed on $np ranks"
+      status=1
+    elif ! sort benchmark.dat-s | cmp -s - serial.sorted; then
+      echo "benchmarkCase $case differs on $np ranks"
+      status=1
+    fi
+  done
+done
+cd "$OLDPWD"
+rm -rf "$dir"
+exit $status
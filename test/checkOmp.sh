@@ -0,0 +1,28 @@
+#!/bin/sh
+# Checks that the relaxation does not depend on the number of OpenMP threads
+# or on the loop schedule. The last case has more matrix elements than are
+# generated in one block, so that several blocks are merged.
+
+status=0
+dir=`mktemp -d` || exit 1
+cd "$dir" || exit 1
+for case in "10 1" "6 2" "20 2"; do
+  OMP_NUM_THREADS=1 "$OLDPWD/benchmarkCase" $case > /dev/null || status=1
+  mv benchmark.dat-s serial.dat-s
+  for threads in 2 3 4; do
+    for schedule in static dynamic,1 guided; do
+      rm -f benchmark.dat-s
+      if ! OMP_NUM_THREADS=$threads OMP_SCHEDULE=$schedule \
+          "$OLDPWD/benchmarkCase" $case > /dev/null; then
+        echo "benchmarkCase $case failed on $threads threads, $schedule"
+        status=1
+      elif ! cmp -s benchmark.dat-s serial.dat-s; then
+        echo "benchmarkCase $case differs on $threads threads, $schedule"
+        status=1
+      fi
+    done
+  done
+done
+cd "$OLDPWD"
+rm -rf "$dir"
+exit $status
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Checks that SdpaReader reads every entry of a written file and rejects a
+# malformed one. With zlib, set CHECK_GZIP=yes to also check that the
+# compressed file decompresses to the plain one and reads the same.
+
+status=0
+dir=`mktemp -d` || exit 1
+cd "$dir" || exit 1
+for case in "10 1" "6 2" "20 2"; do
+  "$OLDPWD/benchmarkCase" $case > /dev/null || status=1
+  mv benchmark.dat-s plain.dat-s
+  # The header takes five lines, every other line is an entry
+  entries=`tail -n +6 plain.dat-s | wc -l`
+  if ! "$OLDPWD/readSdpa" plain.dat-s > plain.count; then
+    echo "benchmarkCase $case cannot be read"
+    status=1
+  elif ! grep -q " $entries entries" plain.count; then
+    echo "benchmarkCase $case reads `cat plain.count`, written $entries"
+    status=1
+  fi
+  if test "$CHECK_GZIP" = yes; then
+    if ! "$OLDPWD/benchmarkCase" $case gzip > /dev/null; then
+      echo "benchmarkCase $case failed to compress"
+      status=1
+    elif ! gzip -dc benchmark.dat-s | cmp -s - plain.dat-s; then
+      echo "benchmarkCase $case decompresses to a different file"
+      status=1
+    elif ! "$OLDPWD/readSdpa" benchmark.dat-s | cmp -s - plain.count; then
+      echo "benchmarkCase $case reads differently compressed"
+      status=1
+    fi
+  fi
+done
+# Entries with a fractional row, a block out of range and trailing text must
+# not be read
+for entry in '1\t1\t1.5\t1\t1' '1\t99\t1\t1\t1' '1\t1\t1\t1\t1\tx'; do
+  head -n 5 plain.dat-s > malformed.dat-s
+  printf "$entry\n" >> malformed.dat-s
+  if "$OLDPWD/readSdpa" malformed.dat-s > /dev/null 2>&1; then
+    echo "a malformed entry is read: $entry"
+    status=1
+  fi
+done
+cd "$OLDPWD"
+rm -rf "$dir"
+exit $status
@@ -0,0 +1,54 @@
+/**
+ * A converter from noncommutative polynomial optimization problems
+ * to sparse SDPA input format
+ *
+ * Copyright (C) 2013 Peter Wittek
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*
+ * An example that streams an SDPA file, plain or compressed with gzip,
+ * through SdpaReader and prints the size of the header and the number of
+ * entries.
+ *
+ */
+
+#include <iostream>
+#include "SdpaReader.h"
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    cerr << "Usage: " << argv[0] << " file" << endl;
+    return 1;
+  }
+  SdpaReader reader;
+  if (!reader.open(argv[1])) {
+    return 1;
+  }
+  long long k, nEntries = 0;
+  int blockIndex, row, column;
+  double value;
+  while (reader.nextEntry(&k, &blockIndex, &row, &column, &value)) {
+    ++nEntries;
+  }
+  if (reader.isMalformed()) {
+    return 1;
+  }
+  cout << reader.nVars << " variables, " << reader.blockStruct.size()
+      << " blocks, " << nEntries << " entries" << endl;
+  return 0;
+}